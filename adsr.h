@@ -1,17 +1,19 @@
 #ifndef ADSR_LIB
 #define ADSR_LIB 1
 
-#include <math.h>
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "fastmath.h"
+#include "smooth.h"
+
 enum envState { env_idle = 0, env_attack, env_decay, env_sustain, env_release };
 
 typedef struct ADSR {
-  float attack;   // seconds
-  float decay;    // seconds
-  float sustain;  // level
-  float release;  // seconds
+  float attack;           // seconds
+  float decay;            // seconds
+  SmoothedParam sustain;  // level
+  float release;          // seconds
   float level;
   float level_attack;
   float level_release;
@@ -24,12 +26,13 @@ typedef struct ADSR {
   float sample_rate;
 } ADSR;
 
-void ADSR_init(ADSR *adsr, float attack, float decay, float sustain,
-               float release, float shape, float sample_rate) {
+static inline void ADSR_init(ADSR *adsr, float attack, float decay,
+                             float sustain, float release, float shape,
+                             float sample_rate) {
   adsr->attack = attack * sample_rate;  // convert s to samples
   adsr->level_attack = 0;
   adsr->decay = decay * sample_rate;  // convert s to samples
-  adsr->sustain = sustain;
+  SmoothedParam_init(&adsr->sustain, sustain);
   adsr->release = release * sample_rate;  // convert s to samples
   adsr->state = env_idle;
   adsr->level = 0;
@@ -41,11 +44,26 @@ void ADSR_init(ADSR *adsr, float attack, float decay, float sustain,
   adsr->sample_rate = sample_rate;
 }
 
-void ADSR_set_release(ADSR *adsr, float release) {
+static inline void ADSR_set_release(ADSR *adsr, float release) {
   adsr->release = release * adsr->sample_rate;
 }
 
-void ADSR_gate(ADSR *adsr, bool gate) {
+// new sustain level, ramped in over the next block
+static inline void ADSR_set_sustain(ADSR *adsr, float sustain) {
+  SmoothedParam_set(&adsr->sustain, sustain);
+}
+
+// call before processing a block of n samples
+static inline void ADSR_begin_block(ADSR *adsr, uint16_t n) {
+  if (adsr->state == env_sustain &&
+      adsr->sustain.target != adsr->sustain.value) {
+    // glide from wherever the decay actually settled
+    adsr->sustain.value = adsr->level / adsr->max;
+  }
+  SmoothedParam_begin_block(&adsr->sustain, n);
+}
+
+static inline void ADSR_gate(ADSR *adsr, bool gate) {
   if (adsr->gate == gate) {
     return;
   }
@@ -59,7 +77,7 @@ void ADSR_gate(ADSR *adsr, bool gate) {
   adsr->sample_counter = 0;
 }
 
-float ADSR_process(ADSR *adsr) {
+static inline float ADSR_process(ADSR *adsr) {
   adsr->sample_counter++;
 
   if (adsr->state == env_attack) {
@@ -67,7 +85,7 @@ float ADSR_process(ADSR *adsr) {
     float curve_shape = adsr->attack / adsr->shape;
     adsr->level =
         adsr->level_start + (adsr->max - adsr->level_start) *
-                                (1.0 - exp(-1.0 * (elapsed / curve_shape)));
+                                (1.0f - fast_expf(-(elapsed / curve_shape)));
     adsr->level_attack = adsr->level;
     adsr->level_release = adsr->level;
     if (elapsed >= adsr->attack) {
@@ -83,9 +101,9 @@ float ADSR_process(ADSR *adsr) {
       adsr->sample_counter = 0;
     } else {
       float curve_shape = adsr->decay / adsr->shape;
-      adsr->level = (adsr->sustain * adsr->max) +
-                    (adsr->level_attack - (adsr->sustain * adsr->max)) *
-                        exp(-1.0 * (elapsed / curve_shape));
+      float sustain = SmoothedParam_next(&adsr->sustain) * adsr->max;
+      adsr->level = sustain + (adsr->level_attack - sustain) *
+                                  fast_expf(-(elapsed / curve_shape));
       adsr->level_release = adsr->level;
     }
   }
@@ -96,16 +114,21 @@ float ADSR_process(ADSR *adsr) {
     // over, which should get close to the adsr->sustain level
     // but sometimes not quite all the way
     // adsr->level = (adsr->sustain * adsr->max);
+    // unless the sustain level itself is being changed
+    if (adsr->sustain.remaining) {
+      adsr->level = SmoothedParam_next(&adsr->sustain) * adsr->max;
+      adsr->level_release = adsr->level;
+    }
   }
 
   if (adsr->state == env_release) {
     uint32_t elapsed = adsr->sample_counter;
-    if (adsr->level < 0.001) {
+    if (adsr->level < 0.001f) {
       adsr->state = env_idle;
       adsr->level = 0;
     } else {
       float curve_shape = adsr->release / adsr->shape;
-      adsr->level = adsr->level_release * exp(-1.0 * (elapsed / curve_shape));
+      adsr->level = adsr->level_release * fast_expf(-(elapsed / curve_shape));
     }
   }
 
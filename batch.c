@@ -0,0 +1,214 @@
+/*
+Batch renderer
+
+Renders many short notes, one job each, for sample library generation. Each
+worker thread owns a single voice synth and a WAV writer, both created before
+the first job. Between jobs the synth is reset in place (voices reinitialized
+and reseeded, reverb cleared) and the writer reopened on its own buffer, so a
+job allocates nothing and workers never touch shared state apart from taking
+the next job index.
+
+Voices are seeded with the job index, so a job list renders the same every
+time regardless of the thread count.
+*/
+
+#include "batch.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "synth.h"
+#include "wav.h"
+
+#define BATCH_SAMPLE_RATE 48000
+#define BATCH_BLOCK 256
+#define BATCH_TAIL 2  // seconds rendered after the note off
+#define BATCH_AMP 0.75f
+#define BATCH_PATH_MAX 256
+
+typedef struct BatchJob {
+  float note;
+  float seconds;
+  float detune;
+  float decay;
+  float damping;
+  char path[BATCH_PATH_MAX];
+} BatchJob;
+
+typedef struct BatchQueue {
+  const BatchJob* jobs;
+  uint32_t numJobs;
+  atomic_uint next;    // index of the next job to take
+  atomic_uint failed;  // jobs whose output could not be written
+} BatchQueue;
+
+typedef struct BatchWorker {
+  pthread_t thread;
+  BatchQueue* queue;
+  Synth* synth;
+  struct sWavWriter* out;
+  uint64_t samples;  // frames rendered by this worker
+} BatchWorker;
+
+/* Parse the job list, returns the number of jobs or -1 on error */
+static int readJobs(const char* path, BatchJob** jobs) {
+  FILE* fp = fopen(path, "r");
+  if (!fp) return -1;
+
+  char line[512];
+  int count = 0, capacity = 0, lineNumber = 0;
+  *jobs = NULL;
+  while (fgets(line, sizeof(line), fp)) {
+    lineNumber++;
+    char* p = line + strspn(line, " \t");
+    if (*p == '#' || *p == '\n' || *p == '\0') continue;
+
+    if (count == capacity) {
+      capacity = capacity ? capacity * 2 : 64;
+      BatchJob* grown = realloc(*jobs, capacity * sizeof(BatchJob));
+      if (!grown) {
+        fprintf(stderr, "%s:%d: out of memory for %d jobs\n", path,
+                lineNumber, capacity);
+        free(*jobs);
+        fclose(fp);
+        return -1;
+      }
+      *jobs = grown;
+    }
+    BatchJob* job = &(*jobs)[count];
+    if (sscanf(p, "%f %f %f %f %f %255s", &job->note, &job->seconds,
+               &job->detune, &job->decay, &job->damping, job->path) != 6) {
+      fprintf(stderr, "%s:%d: expected note seconds detune decay damping "
+              "output\n", path, lineNumber);
+      free(*jobs);
+      fclose(fp);
+      return -1;
+    }
+    // also rules out NaN and infinity, which have no sample count
+    if (!(job->seconds > 0) || !isfinite(job->seconds)) {
+      fprintf(stderr, "%s:%d: seconds must be positive\n", path, lineNumber);
+      free(*jobs);
+      fclose(fp);
+      return -1;
+    }
+    count++;
+  }
+  fclose(fp);
+  return count;
+}
+
+static bool renderJob(BatchWorker* w, const BatchJob* job, uint32_t index) {
+  Synth* s = w->synth;
+  Synth_set_giant_reverb(s);
+  Reverb_setDecay(s->verb, job->decay);
+  Reverb_setDamping(s->verb, job->damping);
+  Synth_reset(s, index);
+
+  uint64_t noteOff = (uint64_t)(job->seconds * BATCH_SAMPLE_RATE);
+  uint64_t total = noteOff + BATCH_TAIL * BATCH_SAMPLE_RATE;
+  Event detune = {.time = 0,
+                  .type = event_param,
+                  .param = param_detune,
+                  .voice = 0,
+                  .value = job->detune};
+  Event on = {.time = 0,
+              .type = event_note_on,
+              .voice = 0,
+              .value = 440 * fast_exp2f((job->note - 69) / 12.0f),
+              .amp = BATCH_AMP};
+  Event off = {.time = noteOff, .type = event_note_off, .voice = 0};
+  Synth_post(s, &detune);
+  Synth_post(s, &on);
+  Synth_post(s, &off);
+
+  if (!WavWriter_open(w->out, job->path)) return false;
+
+  float outL[BATCH_BLOCK], outR[BATCH_BLOCK];
+  while (s->time < total) {
+    uint16_t n = BATCH_BLOCK;
+    if (s->time + n > total) n = total - s->time;
+    Synth_render(s, outL, outR, n);
+    WavWriter_write(w->out, outL, outR, n);
+  }
+  w->samples += total;
+  return WavWriter_close(w->out);
+}
+
+static void* workerMain(void* arg) {
+  BatchWorker* w = arg;
+  BatchQueue* q = w->queue;
+  for (;;) {
+    uint32_t index = atomic_fetch_add(&q->next, 1);
+    if (index >= q->numJobs) break;
+    if (!renderJob(w, &q->jobs[index], index)) {
+      fprintf(stderr, "could not write %s\n", q->jobs[index].path);
+      atomic_fetch_add(&q->failed, 1);
+    }
+  }
+  return NULL;
+}
+
+int Batch_render(const char* path, int threads, uint16_t format,
+                 bool dither) {
+  BatchJob* jobs;
+  int numJobs = readJobs(path, &jobs);
+  if (numJobs < 0) {
+    fprintf(stderr, "could not read job list %s\n", path);
+    return 1;
+  }
+  if (threads <= 0) threads = sysconf(_SC_NPROCESSORS_ONLN);
+  if (threads > numJobs) threads = numJobs;
+  if (threads < 1) threads = 1;
+
+  BatchQueue queue = {.jobs = jobs, .numJobs = numJobs};
+  atomic_init(&queue.next, 0);
+  atomic_init(&queue.failed, 0);
+
+  BatchWorker* workers = calloc(threads, sizeof(BatchWorker));
+  int started = 0;
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; workers && i < threads; i++) {
+    BatchWorker* w = &workers[i];
+    w->queue = &queue;
+    w->synth = Synth_create(1, BATCH_SAMPLE_RATE);
+    w->out = WavWriter_create(2, BATCH_SAMPLE_RATE, format, dither);
+    if (!w->synth || !w->out ||
+        pthread_create(&w->thread, NULL, workerMain, w)) {
+      if (w->synth) Synth_delete(w->synth);
+      if (w->out) WavWriter_delete(w->out);
+      break;
+    }
+    started++;
+  }
+
+  uint64_t samples = 0;
+  for (int i = 0; i < started; i++) {
+    pthread_join(workers[i].thread, NULL);
+    samples += workers[i].samples;
+    Synth_delete(workers[i].synth);
+    WavWriter_delete(workers[i].out);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  free(workers);
+  free(jobs);
+
+  if (!started) {
+    fprintf(stderr, "could not start batch workers\n");
+    return 1;
+  }
+  double seconds =
+      (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+  double rendered = (double)samples / BATCH_SAMPLE_RATE;
+  fprintf(stderr,
+          "rendered %d jobs, %.1f s of audio in %.2f s on %d threads, "
+          "%.1fx realtime\n",
+          numJobs, rendered, seconds, started, rendered / seconds);
+  return atomic_load(&queue.failed) ? 1 : 0;
+}
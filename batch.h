@@ -0,0 +1,16 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Render every job of a job list on a pool of threads (0 = one per core)
+   into stereo WAV files of the given format (WAV_PCM16, WAV_PCM24 or
+   WAV_FLOAT32), optionally dithered. Returns 0 if every job rendered.
+
+   The job list has one job per line, blank lines and lines starting with #
+   are skipped:
+
+     note seconds detune decay damping output
+
+   note is a MIDI note number (fractions allowed), seconds the time the note
+   is held (more than 0), detune the unison spread from 0 to 1, decay and
+   damping the reverb settings from 0 to 1, and output the file written. */
+int Batch_render(const char* path, int threads, uint16_t format, bool dither);
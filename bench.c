@@ -0,0 +1,342 @@
+// Reverb engine benchmark
+//
+// Runs every reverb engine with the "giant reverb" settings from main.c and
+// reports
+// - cost: ns per sample and percent of a 48 kHz real-time budget
+// - decay character from the impulse response: RT60 (from T20), early decay
+//   time, and the left / right correlation of the tail
+// - for the convolution engine, cost per second of impulse response at each
+//   supported partition size
+//
+// With --scaling it instead runs whole-engine scenarios through the same
+// Synth_render path as main.c, sweeping one dimension at a time around a
+// baseline (voices, unison count, sample rate, block size, reverb on / off),
+// and prints realtime factor, p50 / p99 block render time and peak RSS as
+// JSON. Scenario names are stable, so runs from two commits can be diffed.
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "convverb.h"
+#include "fdnverb.h"
+#include "synth.h"
+#include "verb.h"
+
+#define SAMPLE_RATE 48000
+#define BLOCK 256
+#define COST_SECONDS 10
+#define COST_RUNS 3
+#define IR_SECONDS 20
+
+typedef struct BenchEngine {
+  const char *name;
+  void *(*create)(void);
+  void (*process_block)(void *, const float *, float *, float *, uint16_t);
+  void (*delete)(void *);
+} BenchEngine;
+
+static void *dattorro_create(void) {
+  struct sDattorroVerb *v = DattorroVerb_create();
+  DattorroVerb_setPreDelay(v, 0.2);
+  DattorroVerb_setPreFilter(v, 0.9);
+  DattorroVerb_setInputDiffusion1(v, 0.85);
+  DattorroVerb_setInputDiffusion2(v, 0.75);
+  DattorroVerb_setDecayDiffusion(v, 0.5);
+  DattorroVerb_setDecay(v, 0.9);
+  DattorroVerb_setDamping(v, 0.4);
+  return v;
+}
+
+static void dattorro_process_block(void *v, const float *in, float *outL,
+                                   float *outR, uint16_t n) {
+  DattorroVerb_process_block(v, in, outL, outR, n);
+}
+
+static void dattorro_delete(void *v) { DattorroVerb_delete(v); }
+
+static void *fdn_create(void) {
+  struct sFdnVerb *v = FdnVerb_create();
+  FdnVerb_setPreDelay(v, 0.2);
+  FdnVerb_setPreFilter(v, 0.9);
+  FdnVerb_setInputDiffusion1(v, 0.85);
+  FdnVerb_setInputDiffusion2(v, 0.75);
+  FdnVerb_setDecayDiffusion(v, 0.5);
+  FdnVerb_setDecay(v, 0.9);
+  FdnVerb_setDamping(v, 0.4);
+  return v;
+}
+
+static void fdn_process_block(void *v, const float *in, float *outL,
+                              float *outR, uint16_t n) {
+  FdnVerb_process_block(v, in, outL, outR, n);
+}
+
+static void fdn_delete(void *v) { FdnVerb_delete(v); }
+
+static const BenchEngine engines[] = {
+    {"dattorro", dattorro_create, dattorro_process_block, dattorro_delete},
+    {"fdn", fdn_create, fdn_process_block, fdn_delete},
+};
+
+static double now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// deterministic white noise in [-0.5, 0.5)
+static float noise(uint32_t *state) {
+  *state = *state * 1664525u + 1013904223u;
+  return (float)(*state >> 8) / (1 << 24) - 0.5f;
+}
+
+// fastest of COST_RUNS passes over COST_SECONDS of noise, in ns per sample
+static double bench_cost(const BenchEngine *e) {
+  float in[BLOCK], outL[BLOCK], outR[BLOCK];
+  uint32_t seed = 1;
+  double best = 1e30;
+  int blocks = COST_SECONDS * SAMPLE_RATE / BLOCK;
+  float sink = 0;
+
+  for (int run = 0; run < COST_RUNS; run++) {
+    void *v = e->create();
+    double start = now_seconds();
+    for (int b = 0; b < blocks; b++) {
+      for (int i = 0; i < BLOCK; i++) in[i] = noise(&seed);
+      e->process_block(v, in, outL, outR, BLOCK);
+      sink += outL[0] + outR[BLOCK - 1];
+    }
+    double elapsed = now_seconds() - start;
+    if (elapsed < best) best = elapsed;
+    e->delete(v);
+  }
+  if (sink == 12345.0f) printf(" ");  // keep the work observable
+  return best * 1e9 / ((double)blocks * BLOCK);
+}
+
+// time in seconds at which the Schroeder decay curve first falls below db
+static double edc_crossing(const double *edc, int n, double db) {
+  double threshold = edc[0] * pow(10.0, db / 10.0);
+  for (int i = 0; i < n; i++) {
+    if (edc[i] <= threshold) return (double)i / SAMPLE_RATE;
+  }
+  return -1;
+}
+
+static void bench_decay(const BenchEngine *e, double *rt60, double *edt,
+                        double *correlation) {
+  int n = IR_SECONDS * SAMPLE_RATE;
+  float *irL = malloc(n * sizeof(float));
+  float *irR = malloc(n * sizeof(float));
+  double *edc = malloc(n * sizeof(double));
+  float in[BLOCK];
+  void *v = e->create();
+
+  for (int i = 0; i < n; i += BLOCK) {
+    memset(in, 0, sizeof(in));
+    if (i == 0) in[0] = 1;
+    e->process_block(v, in, irL + i, irR + i, BLOCK);
+  }
+  e->delete(v);
+
+  // backward integrated energy (Schroeder)
+  double sum = 0;
+  for (int i = n - 1; i >= 0; i--) {
+    sum += (double)irL[i] * (double)irL[i] + (double)irR[i] * (double)irR[i];
+    edc[i] = sum;
+  }
+
+  double t5 = edc_crossing(edc, n, -5);
+  double t25 = edc_crossing(edc, n, -25);
+  double t10 = edc_crossing(edc, n, -10);
+  *rt60 = (t5 < 0 || t25 < 0) ? -1 : 3 * (t25 - t5);
+  *edt = t10 < 0 ? -1 : 6 * t10;
+
+  // left / right correlation over the tail after 100 ms
+  double lr = 0, ll = 0, rr = 0;
+  for (int i = SAMPLE_RATE / 10; i < n; i++) {
+    lr += (double)irL[i] * (double)irR[i];
+    ll += (double)irL[i] * (double)irL[i];
+    rr += (double)irR[i] * (double)irR[i];
+  }
+  *correlation = (ll > 0 && rr > 0) ? lr / sqrt(ll * rr) : 0;
+
+  free(irL);
+  free(irR);
+  free(edc);
+}
+
+// cost of convolving with a synthetic stereo IR of ir_seconds, in ns per
+// output sample
+static double bench_convolution(int ir_seconds, uint16_t partition) {
+  uint32_t frames = ir_seconds * SAMPLE_RATE;
+  float *ir = malloc(frames * 2 * sizeof(float));
+  float in[BLOCK], outL[BLOCK], outR[BLOCK];
+  uint32_t seed = 1;
+  float sink = 0;
+
+  for (uint32_t i = 0; i < frames; i++) {
+    float envelope = expf(-6.9f * i / frames);
+    ir[i * 2] = noise(&seed) * envelope;
+    ir[i * 2 + 1] = noise(&seed) * envelope;
+  }
+  struct sConvVerb *v = ConvVerb_create(ir, 2, frames, partition);
+  free(ir);
+
+  int blocks = COST_SECONDS * SAMPLE_RATE / BLOCK;
+  double start = now_seconds();
+  for (int b = 0; b < blocks; b++) {
+    for (int i = 0; i < BLOCK; i++) in[i] = noise(&seed);
+    ConvVerb_process_block(v, in, outL, outR, BLOCK);
+    sink += outL[0] + outR[BLOCK - 1];
+  }
+  double elapsed = now_seconds() - start;
+  ConvVerb_delete(v);
+  if (sink == 12345.0f) printf(" ");  // keep the work observable
+  return elapsed * 1e9 / ((double)blocks * BLOCK);
+}
+
+// -- Whole-engine scaling scenarios --
+
+#define SCALING_SECONDS 2
+
+typedef struct Scenario {
+  const char *sweep;  // dimension varied from the baseline
+  uint16_t voices;
+  uint8_t unison;
+  uint32_t sample_rate;
+  uint16_t block;
+  bool reverb;
+} Scenario;
+
+static const Scenario baseline = {"baseline", 16, LFSAWS_MAX, 48000, 256, true};
+
+static int compare_double(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+// render SCALING_SECONDS with every voice holding a note and print one JSON
+// object
+static void run_scenario(const Scenario *sc, bool last) {
+  Synth *s = Synth_create(sc->voices, sc->sample_rate);
+  Synth_set_giant_reverb(s);
+  s->bypass = !sc->reverb;
+  for (int i = 0; i < sc->voices; i++) {
+    LFSaws_set_unison(&s->voices[i].saws, sc->unison);
+    // a distinct channel / note per voice, so none is retriggered
+    Synth_note_on(s, 0, i / 48, 36 + i % 48, 0.5f);
+  }
+
+  int blocks = SCALING_SECONDS * sc->sample_rate / sc->block;
+  double *times = malloc(blocks * sizeof(double));
+  float *outL = malloc(sc->block * sizeof(float));
+  float *outR = malloc(sc->block * sizeof(float));
+  double total = 0;
+  float sink = 0;
+  for (int b = 0; b < blocks; b++) {
+    double start = now_seconds();
+    Synth_render(s, outL, outR, sc->block);
+    times[b] = now_seconds() - start;
+    total += times[b];
+    sink += outL[0] + outR[sc->block - 1];
+  }
+  if (sink == 12345.0f) fprintf(stderr, " ");  // keep the work observable
+
+  qsort(times, blocks, sizeof(double), compare_double);
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  double audio = (double)blocks * sc->block / sc->sample_rate;
+  printf(
+      "    {\"sweep\": \"%s\", \"voices\": %d, \"unison\": %d, "
+      "\"sample_rate\": %u, \"block\": %d, \"reverb\": %s,\n"
+      "     \"realtime\": %.2f, \"block_p50_us\": %.3f, "
+      "\"block_p99_us\": %.3f, \"peak_rss_kb\": %ld}%s\n",
+      sc->sweep, sc->voices, sc->unison, sc->sample_rate, sc->block,
+      sc->reverb ? "true" : "false", audio / total, times[blocks / 2] * 1e6,
+      times[blocks * 99 / 100] * 1e6, usage.ru_maxrss, last ? "" : ",");
+  fflush(stdout);
+
+  free(times);
+  free(outL);
+  free(outR);
+  Synth_delete(s);
+}
+
+// Peak RSS is the process high-water mark (getrusage), so within one run it
+// only grows; the sweeps go from small to large to keep it meaningful.
+static void bench_scaling(void) {
+  static const uint16_t voices[] = {1, 2, 4, 8, 16, 32, 64, 128, 256};
+  static const uint8_t unison[] = {1, 3, 5, 7};
+  static const uint32_t rates[] = {44100, 48000, 96000};
+  static const uint16_t blocks[] = {32, 64, 128, 256, 512, 1024};
+  Scenario list[64];
+  int n = 0;
+
+  list[n++] = baseline;
+  for (size_t i = 0; i < sizeof(voices) / sizeof(voices[0]); i++) {
+    list[n] = baseline;
+    list[n].sweep = "voices";
+    list[n++].voices = voices[i];
+  }
+  for (size_t i = 0; i < sizeof(unison) / sizeof(unison[0]); i++) {
+    list[n] = baseline;
+    list[n].sweep = "unison";
+    list[n++].unison = unison[i];
+  }
+  for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+    list[n] = baseline;
+    list[n].sweep = "sample_rate";
+    list[n++].sample_rate = rates[i];
+  }
+  for (size_t i = 0; i < sizeof(blocks) / sizeof(blocks[0]); i++) {
+    list[n] = baseline;
+    list[n].sweep = "block";
+    list[n++].block = blocks[i];
+  }
+  for (int reverb = 0; reverb <= 1; reverb++) {
+    list[n] = baseline;
+    list[n].sweep = "reverb";
+    list[n++].reverb = reverb;
+  }
+
+  printf("{\n  \"engine\": \"%s\",\n  \"seconds\": %d,\n"
+         "  \"scenarios\": [\n",
+         REVERB_NAME, SCALING_SECONDS);
+  for (int i = 0; i < n; i++) run_scenario(&list[i], i == n - 1);
+  printf("  ]\n}\n");
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 1 && !strcmp(argv[1], "--scaling")) {
+    bench_scaling();
+    return 0;
+  }
+
+  printf("%-10s %10s %10s %9s %9s %9s\n", "engine", "ns/sample", "realtime",
+         "RT60 (s)", "EDT (s)", "L/R corr");
+  for (size_t i = 0; i < sizeof(engines) / sizeof(engines[0]); i++) {
+    const BenchEngine *e = &engines[i];
+    double ns = bench_cost(e);
+    double rt60, edt, correlation;
+    bench_decay(e, &rt60, &edt, &correlation);
+    printf("%-10s %10.1f %9.2f%% %9.2f %9.2f %9.3f\n", e->name, ns,
+           ns * SAMPLE_RATE / 1e7, rt60, edt, correlation);
+  }
+
+  printf("\n%-10s %10s %10s %10s %14s\n", "partition", "IR (s)", "ns/sample",
+         "realtime", "ns/sample/IR-s");
+  for (uint16_t partition = CONVVERB_MIN_BLOCK;
+       partition <= CONVVERB_MAX_BLOCK; partition <<= 1) {
+    for (int ir_seconds = 1; ir_seconds <= 4; ir_seconds <<= 1) {
+      double ns = bench_convolution(ir_seconds, partition);
+      printf("%-10d %10d %10.1f %9.2f%% %14.1f\n", partition, ir_seconds, ns,
+             ns * SAMPLE_RATE / 1e7, ns / ir_seconds);
+    }
+  }
+  return 0;
+}
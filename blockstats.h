@@ -0,0 +1,109 @@
+#ifndef BLOCKSTATS_LIB
+#define BLOCKSTATS_LIB 1
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// Per-block render time statistics
+//
+// The audio thread records how long every block took to render, in whatever
+// tick the platform has at hand (microseconds from time_us_32 on the Pico,
+// nanoseconds on the host), into a log2 histogram: bucket 0 counts zero
+// ticks and bucket k counts times in [2^(k-1), 2^k). Blocks slower than the
+// deadline are counted as misses, and the slowest block is kept, all since
+// the last reset. Recording is a count-leading-zeros, a few adds and two
+// sequence counter stores, cheap enough for every block.
+//
+// Another thread or core reads the numbers with BlockStats_snapshot. The
+// sequence counter is odd while the audio thread is updating, so a reader
+// copies until it sees the same even count before and after and never gets
+// a torn snapshot; the audio thread never waits. Resets are requested by
+// the reader and carried out by the audio thread at its next block.
+
+#define BLOCKSTATS_BUCKETS 33
+
+typedef struct BlockStatsSnapshot {
+  uint32_t deadline;  // ticks available per block
+  uint32_t blocks;    // blocks recorded since the last reset
+  uint32_t misses;    // blocks slower than the deadline
+  uint32_t max;       // slowest block
+  uint64_t total;     // sum of all block times
+  uint32_t histogram[BLOCKSTATS_BUCKETS];
+} BlockStatsSnapshot;
+
+typedef struct BlockStats {
+  _Atomic uint32_t sequence;  // odd while the audio thread is writing
+  atomic_bool reset;          // set by the reader, cleared by the writer
+  BlockStatsSnapshot stats;
+} BlockStats;
+
+static inline void BlockStats_init(BlockStats *b, uint32_t deadline) {
+  memset(&b->stats, 0, sizeof(b->stats));
+  b->stats.deadline = deadline;
+  atomic_init(&b->sequence, 0);
+  atomic_init(&b->reset, false);
+}
+
+static inline uint8_t BlockStats_bucket(uint32_t ticks) {
+  return ticks ? 32 - __builtin_clz(ticks) : 0;
+}
+
+// Audio thread: record the render time of one block
+static inline void BlockStats_record(BlockStats *b, uint32_t ticks) {
+  BlockStatsSnapshot *s = &b->stats;
+  uint32_t sequence = atomic_load_explicit(&b->sequence, memory_order_relaxed);
+  atomic_store_explicit(&b->sequence, sequence + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  if (atomic_load_explicit(&b->reset, memory_order_relaxed)) {
+    uint32_t deadline = s->deadline;
+    memset(s, 0, sizeof(*s));
+    s->deadline = deadline;
+    atomic_store_explicit(&b->reset, false, memory_order_relaxed);
+  }
+  s->blocks++;
+  s->total += ticks;
+  if (ticks > s->deadline) s->misses++;
+  if (ticks > s->max) s->max = ticks;
+  s->histogram[BlockStats_bucket(ticks)]++;
+  atomic_store_explicit(&b->sequence, sequence + 2, memory_order_release);
+}
+
+// Any thread: copy the current statistics into out, and if reset is true
+// ask the audio thread to start counting afresh from its next block
+static inline void BlockStats_snapshot(BlockStats *b, BlockStatsSnapshot *out,
+                                       bool reset) {
+  uint32_t before, after;
+  do {
+    before = atomic_load_explicit(&b->sequence, memory_order_acquire);
+    memcpy(out, &b->stats, sizeof(*out));
+    atomic_thread_fence(memory_order_acquire);
+    after = atomic_load_explicit(&b->sequence, memory_order_relaxed);
+  } while ((before & 1) || before != after);
+  if (reset) atomic_store_explicit(&b->reset, true, memory_order_relaxed);
+}
+
+// Upper bound of the bucket holding the given fraction (0..1) of blocks,
+// e.g. 0.99 for the 99th percentile, capped at the slowest block. Within a
+// factor of two of the truth.
+static inline uint32_t BlockStats_percentile(const BlockStatsSnapshot *s,
+                                             float fraction) {
+  uint32_t rank = (uint32_t)(fraction * s->blocks);
+  uint32_t count = 0;
+  for (int k = 0; k < BLOCKSTATS_BUCKETS; k++) {
+    count += s->histogram[k];
+    if (count > rank) {
+      uint32_t bound = k == 32 ? UINT32_MAX : (1u << k) - 1;
+      return bound < s->max ? bound : s->max;
+    }
+  }
+  return s->max;
+}
+
+// Mean block time in ticks
+static inline uint32_t BlockStats_mean(const BlockStatsSnapshot *s) {
+  return s->blocks ? (uint32_t)(s->total / s->blocks) : 0;
+}
+
+#endif
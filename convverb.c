@@ -0,0 +1,186 @@
+/*
+Uniformly partitioned convolution reverb
+
+Convolves the mono send with a captured (mono or stereo) impulse response
+using overlap-save on FFT blocks of twice the partition size.
+
+The impulse response is cut into P partitions of B samples. Each partition
+is transformed once at creation time. Every B input samples:
+1. The last 2B input samples are transformed (one forward FFT)
+2. The spectrum is pushed into the frequency-domain delay line (FDL), a ring
+   of the last P input spectra
+3. Each FDL entry is multiplied with the partition of matching age and
+   accumulated, so the whole IR costs P complex multiply-adds per bin
+4. One inverse FFT returns the block, of which the last B samples are valid
+
+Both output channels share one complex transform. Left and right partitions
+are packed as HL + i*HR, which is what transforming hL + i*hR gives. Since
+the input is real, the inverse of X*(HL + i*HR) is yL + i*yR, so the left
+output comes out in the real part and the right output in the imaginary
+part.
+*/
+
+#include "convverb.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "fft.h"
+
+/* ConvVerb context */
+typedef struct sConvVerb {
+  struct sFft* fft;
+
+  uint16_t blockSize;   // B, samples per partition
+  uint32_t fftSize;     // 2B
+  uint32_t partitions;  // P
+
+  // Partition spectra (HL + i*HR), P x fftSize, scaled by 1 / fftSize
+  float* irRe;
+  float* irIm;
+
+  // Frequency-domain delay line, P x fftSize, fdlHead is the newest slot
+  float* fdlRe;
+  float* fdlIm;
+  uint32_t fdlHead;
+
+  // Last 2B input samples, oldest first
+  float* input;
+
+  // Transform scratch and accumulator
+  float* workRe;
+  float* workIm;
+
+  // Samples written into the current input block
+  uint16_t pos;
+} ConvVerb;
+
+/* Multiply-accumulate spectrum x * h into acc */
+static void complexMac(float* accRe, float* accIm, const float* xRe,
+                       const float* xIm, const float* hRe, const float* hIm,
+                       uint32_t n) {
+  for (uint32_t k = 0; k < n; k++) {
+    accRe[k] += xRe[k] * hRe[k] - xIm[k] * hIm[k];
+    accIm[k] += xRe[k] * hIm[k] + xIm[k] * hRe[k];
+  }
+}
+
+/* Get pointer to convolution reverb for an impulse response */
+ConvVerb* ConvVerb_create(const float* ir, uint16_t channels, uint32_t frames,
+                          uint16_t blockSize) {
+  if (blockSize < CONVVERB_MIN_BLOCK || blockSize > CONVVERB_MAX_BLOCK ||
+      (blockSize & (blockSize - 1)) || channels < 1 || frames < 1) {
+    return NULL;
+  }
+
+  ConvVerb* v = calloc(1, sizeof(ConvVerb));
+  if (!v) return NULL;
+
+  v->blockSize = blockSize;
+  v->fftSize = 2 * blockSize;
+  v->partitions = (frames + blockSize - 1) / blockSize;
+
+  size_t spectra = (size_t)v->partitions * v->fftSize;
+  v->fft = Fft_create(v->fftSize);
+  v->irRe = calloc(spectra, sizeof(float));
+  v->irIm = calloc(spectra, sizeof(float));
+  v->fdlRe = calloc(spectra, sizeof(float));
+  v->fdlIm = calloc(spectra, sizeof(float));
+  v->input = calloc(v->fftSize, sizeof(float));
+  v->workRe = calloc(v->fftSize, sizeof(float));
+  v->workIm = calloc(v->fftSize, sizeof(float));
+  if (!v->fft || !v->irRe || !v->irIm || !v->fdlRe || !v->fdlIm ||
+      !v->input || !v->workRe || !v->workIm) {
+    ConvVerb_delete(v);
+    return NULL;
+  }
+
+  // Transform each partition, left into the real part and right (or left
+  // again for a mono IR) into the imaginary part
+  float scale = 1.0f / v->fftSize;
+  uint16_t right = channels > 1 ? 1 : 0;
+  for (uint32_t p = 0; p < v->partitions; p++) {
+    float* re = v->irRe + (size_t)p * v->fftSize;
+    float* im = v->irIm + (size_t)p * v->fftSize;
+    for (uint32_t i = 0; i < blockSize; i++) {
+      uint32_t frame = p * blockSize + i;
+      if (frame >= frames) break;
+      re[i] = ir[(size_t)frame * channels] * scale;
+      im[i] = ir[(size_t)frame * channels + right] * scale;
+    }
+    Fft_forward(v->fft, re, im);
+  }
+  return v;
+}
+
+/* Free resources and delete ConvVerb instance */
+void ConvVerb_delete(ConvVerb* v) {
+  Fft_delete(v->fft);
+  free(v->irRe);
+  free(v->irIm);
+  free(v->fdlRe);
+  free(v->fdlIm);
+  free(v->input);
+  free(v->workRe);
+  free(v->workIm);
+  free(v);
+}
+
+/* Convolve the full input block, leaving yL + i*yR in the work buffers */
+static void processPartitions(ConvVerb* v) {
+  uint32_t n = v->fftSize;
+
+  // Transform the last two input blocks into the newest FDL slot
+  v->fdlHead = (v->fdlHead + v->partitions - 1) % v->partitions;
+  float* xRe = v->fdlRe + (size_t)v->fdlHead * n;
+  float* xIm = v->fdlIm + (size_t)v->fdlHead * n;
+  memcpy(xRe, v->input, n * sizeof(float));
+  memset(xIm, 0, n * sizeof(float));
+  Fft_forward(v->fft, xRe, xIm);
+
+  // Input spectrum p blocks old meets IR partition p
+  memset(v->workRe, 0, n * sizeof(float));
+  memset(v->workIm, 0, n * sizeof(float));
+  uint32_t slot = v->fdlHead;
+  for (uint32_t p = 0; p < v->partitions; p++) {
+    complexMac(v->workRe, v->workIm, v->fdlRe + (size_t)slot * n,
+               v->fdlIm + (size_t)slot * n, v->irRe + (size_t)p * n,
+               v->irIm + (size_t)p * n, n);
+    if (++slot == v->partitions) slot = 0;
+  }
+  Fft_inverse(v->fft, v->workRe, v->workIm);
+
+  // Slide the input window by one block
+  memcpy(v->input, v->input + v->blockSize, v->blockSize * sizeof(float));
+}
+
+// Process mono audio in blocks
+//
+// Writes n samples of wet stereo reverb into outL / outR, delayed by one
+// partition
+void ConvVerb_process_block(ConvVerb* v, const float* in, float* outL,
+                            float* outR, uint16_t n) {
+  uint16_t b = v->blockSize;
+
+  while (n) {
+    uint16_t m = b - v->pos;
+    if (m > n) m = n;
+
+    // The valid half of the previous result lines up with the block being
+    // filled, giving a constant latency of one partition
+    memcpy(v->input + b + v->pos, in, m * sizeof(float));
+    memcpy(outL, v->workRe + b + v->pos, m * sizeof(float));
+    memcpy(outR, v->workIm + b + v->pos, m * sizeof(float));
+
+    v->pos += m;
+    in += m;
+    outL += m;
+    outR += m;
+    n -= m;
+
+    if (v->pos == b) {
+      processPartitions(v);
+      v->pos = 0;
+    }
+  }
+}
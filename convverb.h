@@ -0,0 +1,22 @@
+#include <stdint.h>
+
+struct sConvVerb;
+
+/* Smallest and largest supported partition (block) size */
+#define CONVVERB_MIN_BLOCK 64
+#define CONVVERB_MAX_BLOCK 1024
+
+/* Get pointer to convolution reverb for an interleaved mono or stereo
+   impulse response, partitioned into blockSize sample blocks (power of two
+   between CONVVERB_MIN_BLOCK and CONVVERB_MAX_BLOCK). The impulse response
+   is copied, the caller keeps ownership of ir. */
+struct sConvVerb* ConvVerb_create(const float* ir, uint16_t channels,
+                                  uint32_t frames, uint16_t blockSize);
+
+/* Free resources and delete ConvVerb instance */
+void ConvVerb_delete(struct sConvVerb* v);
+
+/* Process n mono input samples into wet stereo output. Output lags the
+   input by blockSize samples, n does not have to match blockSize. */
+void ConvVerb_process_block(struct sConvVerb* v, const float* in, float* outL,
+                            float* outR, uint16_t n);
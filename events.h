@@ -0,0 +1,83 @@
+#ifndef EVENTS_LIB
+#define EVENTS_LIB 1
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Sample-accurate event queue
+//
+// Every event carries the absolute sample time it takes effect at. The
+// renderer applies all events due at its current position and then renders
+// uninterrupted up to the time of the next one, so block boundaries never
+// quantize note timing and the per-sample loops carry no event checks.
+//
+// The queue is owned by the rendering thread. Events are normally posted in
+// time order, which appends in O(1); an out-of-order event is moved back into
+// place, after any events already queued for the same sample.
+
+enum eventType { event_note_on = 0, event_note_off, event_gate, event_param };
+
+enum eventParam {
+  param_freq = 0,  // voice frequency, Hz
+  param_amp,       // voice amplitude
+  param_filter,    // voice one pole coefficient
+  param_sustain,   // voice sustain level
+  param_release,   // voice release, seconds
+  param_detune,    // voice unison spread, 0 to 1
+  param_reverb_decay,
+  param_reverb_damping,
+};
+
+typedef struct Event {
+  uint64_t time;   // sample the event takes effect at
+  uint8_t type;    // enum eventType
+  uint8_t param;   // event_param: enum eventParam
+  uint16_t voice;  // target voice, unused for reverb parameters
+  float value;     // note on: frequency, gate: 0 or 1, param: new value
+  float amp;       // note on: amplitude
+} Event;
+
+#define EVENT_QUEUE_SIZE 1024  // power of two
+#define EVENT_QUEUE_MASK (EVENT_QUEUE_SIZE - 1)
+
+typedef struct EventQueue {
+  Event events[EVENT_QUEUE_SIZE];
+  uint32_t head;   // index of the earliest event
+  uint32_t count;  // events queued
+} EventQueue;
+
+static inline void EventQueue_init(EventQueue *q) {
+  q->head = 0;
+  q->count = 0;
+}
+
+// Queue an event, returns false if the queue is full
+static inline bool EventQueue_push(EventQueue *q, const Event *e) {
+  if (q->count == EVENT_QUEUE_SIZE) {
+    return false;
+  }
+  uint32_t i = q->count++;
+  while (i > 0) {
+    Event *prev = &q->events[(q->head + i - 1) & EVENT_QUEUE_MASK];
+    if (prev->time <= e->time) {
+      break;
+    }
+    q->events[(q->head + i) & EVENT_QUEUE_MASK] = *prev;
+    i--;
+  }
+  q->events[(q->head + i) & EVENT_QUEUE_MASK] = *e;
+  return true;
+}
+
+// Earliest queued event, or NULL if there is none
+static inline const Event *EventQueue_peek(const EventQueue *q) {
+  return q->count ? &q->events[q->head] : NULL;
+}
+
+static inline void EventQueue_pop(EventQueue *q) {
+  q->head = (q->head + 1) & EVENT_QUEUE_MASK;
+  q->count--;
+}
+
+#endif
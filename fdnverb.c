@@ -0,0 +1,304 @@
+/*
+8-line feedback delay network reverb
+
+Drop-in alternative to the Dattorro plate in verb.c. The plate runs one long
+serial chain per sample (four input allpasses, then two tank halves that
+feed each other), so there is little for the CPU to do in parallel. This
+engine keeps the same input conditioning but replaces the tank with eight
+independent delay lines that are mixed through an orthonormal Hadamard
+matrix on every step. All per-line work (damping, gain, mixing, write-back)
+is written as the same operation applied across eight lanes so that the
+compiler can vectorize it. How much it does depends on the compiler and
+target; gcc -O3 -fopt-info-vec -c fdnverb.c lists the loops it vectorized
+(on x86-64, gcc vectorizes the Hadamard butterflies and the write-back).
+
+FdnVerb_setDecayDiffusion is accepted but ignored: the Hadamard mix is the
+tank's diffusion. See the note in reverb.h.
+
+Mono input signal flow (function FdnVerb_process_block):
+1. Pre-delay
+2. Input filter (low pass)
+3. Input diffusor x 2 (all pass filter)
+4. Delay network, for each step:
+   4.1 Read the output of all 8 lines
+   4.2 Tap left / right outputs from orthogonal sign patterns of the lines
+   4.3 Damping (low pass filter) and per-line decay gain
+   4.4 8x8 Hadamard mix (fast Walsh-Hadamard transform)
+   4.5 Add input and write back into the lines
+
+Line gains are derived from the decay setting so that every line loses
+the same amount of energy per second, which keeps the decay exponential
+regardless of which line a component is travelling through.
+*/
+
+#include "fdnverb.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fastmath.h"
+#include "fdnverb_structs.h"
+
+#define MAX_PREDELAY 4800  // 100ms for 48k samplerate
+
+// Mutually prime line lengths, roughly 24ms - 65ms at 48k
+static const uint16_t lineLengths[FDN_LINES] = {1153, 1327, 1559, 1801,
+                                                2053, 2399, 2713, 3109};
+
+// Loop length (in samples) over which one decay step is applied. Chosen so
+// that a given decay setting rings about as long as the Dattorro tank.
+#define DECAY_REFERENCE_LENGTH 5400.0f
+
+// Orthogonal sign patterns used to inject input and tap stereo output
+static const float inputSign[FDN_LINES] = {1, 1, 1, 1, 1, 1, 1, 1};
+static const float outputSignL[FDN_LINES] = {1, -1, 1, -1, 1, -1, 1, -1};
+static const float outputSignR[FDN_LINES] = {1, 1, -1, -1, 1, 1, -1, -1};
+
+#define INPUT_GAIN 0.35355339f  // 1 / sqrt(FDN_LINES)
+#define OUTPUT_GAIN 1.0f
+#define HADAMARD_NORM 0.35355339f  // 1 / sqrt(FDN_LINES)
+
+/* Allocate a zeroed power-of-two buffer that holds at least delay samples */
+static float* allocBuffer(uint16_t delay, uint16_t stride, uint16_t* mask) {
+  uint16_t numBits = 0;
+  uint16_t x = delay;
+
+  while (x) {
+    numBits++;
+    x >>= 1;
+  }
+
+  *mask = (1 << numBits) - 1;
+  return calloc((size_t)(*mask + 1) * stride, sizeof(float));
+}
+
+/* In-place unnormalized 8 point Walsh-Hadamard transform */
+static inline void hadamard(float* x) {
+  for (int s = 1; s < FDN_LINES; s <<= 1) {
+    for (int i = 0; i < FDN_LINES; i += s << 1) {
+      for (int j = i; j < i + s; j++) {
+        float a = x[j];
+        float b = x[j + s];
+        x[j] = a + b;
+        x[j + s] = a - b;
+      }
+    }
+  }
+}
+
+/* Apply all-pass filter */
+static inline float allPass(float* buffer, uint16_t mask, uint16_t length,
+                            uint16_t t, float gain, float in) {
+  float delayed = buffer[(uint16_t)(t - length) & mask];
+  in += delayed * -gain;
+  buffer[t & mask] = in;
+  return delayed + in * gain;
+}
+
+/* Set pre-delay length (relative to MAX_PREDELAY) */
+void FdnVerb_setPreDelay(FdnVerb* v, float value) {
+  v->preDelayLength = value * MAX_PREDELAY;
+}
+
+/* Set pre-filter amount */
+void FdnVerb_setPreFilter(FdnVerb* v, float value) {
+  SmoothedParam_set(&v->preFilterAmount, value);
+}
+
+/* Set input diffusion 1 amount */
+void FdnVerb_setInputDiffusion1(FdnVerb* v, float value) {
+  SmoothedParam_set(&v->inputDiffusion1Amount, value);
+}
+
+/* Set input diffusion 2 amount */
+void FdnVerb_setInputDiffusion2(FdnVerb* v, float value) {
+  SmoothedParam_set(&v->inputDiffusion2Amount, value);
+}
+
+/* Accepted for API compatibility and ignored, the Hadamard mix sets the tank
+   diffusion */
+void FdnVerb_setDecayDiffusion(FdnVerb* v, float value) {
+  v->decayDiffusionAmount = value;
+}
+
+/* Set decay amount and derive per-line loop gains */
+void FdnVerb_setDecay(FdnVerb* v, float value) {
+  v->decayAmount = value;
+  for (int i = 0; i < FDN_LINES; i++) {
+    float exponent = v->lineLength[i] / DECAY_REFERENCE_LENGTH;
+    SmoothedParam_set(&v->lineGain[i],
+                      HADAMARD_NORM * fast_powf(value, exponent));
+  }
+}
+
+/* Set damping amount */
+void FdnVerb_setDamping(FdnVerb* v, float value) {
+  SmoothedParam_set(&v->dampingAmount, value);
+}
+
+/* Set up settings ramps for a block of n samples, true if any moves */
+static bool beginParams(FdnVerb* v, uint16_t n) {
+  bool moving = false;
+  moving |= SmoothedParam_begin_block(&v->preFilterAmount, n);
+  moving |= SmoothedParam_begin_block(&v->inputDiffusion1Amount, n);
+  moving |= SmoothedParam_begin_block(&v->inputDiffusion2Amount, n);
+  moving |= SmoothedParam_begin_block(&v->dampingAmount, n);
+  for (int i = 0; i < FDN_LINES; i++) {
+    moving |= SmoothedParam_begin_block(&v->lineGain[i], n);
+  }
+  return moving;
+}
+
+/* Advance the settings ramps by one sample */
+static void rampParams(FdnVerb* v) {
+  SmoothedParam_next(&v->preFilterAmount);
+  SmoothedParam_next(&v->inputDiffusion1Amount);
+  SmoothedParam_next(&v->inputDiffusion2Amount);
+  SmoothedParam_next(&v->dampingAmount);
+  for (int i = 0; i < FDN_LINES; i++) {
+    SmoothedParam_next(&v->lineGain[i]);
+  }
+}
+
+/* Get pointer to initialized FdnVerb instance */
+FdnVerb* FdnVerb_create(void) {
+  FdnVerb* v = malloc(sizeof(FdnVerb));
+  if (!v) return NULL;
+
+  memset(v, 0, sizeof(FdnVerb));
+
+  v->preDelay = allocBuffer(MAX_PREDELAY, 1, &v->preDelayMask);
+
+  v->inDiffusionLength[0] = 149;
+  v->inDiffusionLength[1] = 383;
+  for (int i = 0; i < 2; i++) {
+    v->inDiffusion[i] =
+        allocBuffer(v->inDiffusionLength[i], 1, &v->inDiffusionMask[i]);
+  }
+
+  memcpy(v->lineLength, lineLengths, sizeof(lineLengths));
+  v->lines = allocBuffer(lineLengths[FDN_LINES - 1], FDN_LINES, &v->lineMask);
+
+  if (!v->preDelay || !v->inDiffusion[0] || !v->inDiffusion[1] ||
+      !v->lines) {
+    FdnVerb_delete(v);
+    return NULL;
+  }
+
+  // Default settings, same as DattorroVerb
+  FdnVerb_setPreDelay(v, 0.1);
+  FdnVerb_setPreFilter(v, 0.85);
+  FdnVerb_setInputDiffusion1(v, 0.75);
+  FdnVerb_setInputDiffusion2(v, 0.625);
+  FdnVerb_setDecay(v, 0.75);
+  FdnVerb_setDecayDiffusion(v, 0.70);
+  FdnVerb_setDamping(v, 0.95);
+
+  // Start on the defaults instead of ramping up from zero
+  beginParams(v, 1);
+  rampParams(v);
+  return v;
+}
+
+/* Free resources and delete FdnVerb instance */
+void FdnVerb_delete(FdnVerb* v) {
+  free(v->preDelay);
+  free(v->inDiffusion[0]);
+  free(v->inDiffusion[1]);
+  free(v->lines);
+  free(v);
+}
+
+/* Silence the network for reuse, settings made so far apply without ramping */
+void FdnVerb_clear(FdnVerb* v) {
+  memset(v->preDelay, 0, (v->preDelayMask + 1) * sizeof(float));
+  for (int i = 0; i < 2; i++) {
+    memset(v->inDiffusion[i], 0, (v->inDiffusionMask[i] + 1) * sizeof(float));
+  }
+  memset(v->lines, 0, (size_t)(v->lineMask + 1) * FDN_LINES * sizeof(float));
+  memset(v->damping, 0, sizeof(v->damping));
+  v->preFilter = 0;
+  v->outL = 0;
+  v->outR = 0;
+  v->t = 0;
+
+  beginParams(v, 1);
+  rampParams(v);
+}
+
+// Process mono audio in blocks
+//
+// Writes n samples of wet stereo reverb into outL / outR. Settings changed
+// since the previous call ramp linearly to their new values across the block.
+void FdnVerb_process_block(FdnVerb* v, const float* in, float* outL,
+                           float* outR, uint16_t n) {
+  bool ramping = beginParams(v, n);
+
+  for (uint16_t k = 0; k < n; k++) {
+    uint16_t t = v->t;
+    if (ramping) rampParams(v);
+    float x, y[FDN_LINES];
+    float l = 0, r = 0;
+
+    // Pre-delay
+    v->preDelay[t & v->preDelayMask] = in[k];
+    x = v->preDelay[(uint16_t)(t - v->preDelayLength) & v->preDelayMask];
+
+    // Pre-filter
+    v->preFilter += (x - v->preFilter) * v->preFilterAmount.value;
+    x = v->preFilter;
+
+    // Input diffusion
+    x = allPass(v->inDiffusion[0], v->inDiffusionMask[0],
+                v->inDiffusionLength[0], t, v->inputDiffusion1Amount.value, x);
+    x = allPass(v->inDiffusion[1], v->inDiffusionMask[1],
+                v->inDiffusionLength[1], t, v->inputDiffusion2Amount.value, x);
+    x *= INPUT_GAIN;
+
+    // Line outputs
+    for (int i = 0; i < FDN_LINES; i++) {
+      uint16_t frame = (uint16_t)(t - v->lineLength[i]) & v->lineMask;
+      y[i] = v->lines[frame * FDN_LINES + i];
+    }
+
+    // Stereo taps
+    for (int i = 0; i < FDN_LINES; i++) {
+      l += y[i] * outputSignL[i];
+      r += y[i] * outputSignR[i];
+    }
+    outL[k] = l * OUTPUT_GAIN;
+    outR[k] = r * OUTPUT_GAIN;
+
+    // Damping and loop gain
+    for (int i = 0; i < FDN_LINES; i++) {
+      v->damping[i] += (y[i] - v->damping[i]) * v->dampingAmount.value;
+      y[i] = v->damping[i] * v->lineGain[i].value;
+    }
+
+    // Mix and feed back
+    hadamard(y);
+    float* w = v->lines + (t & v->lineMask) * FDN_LINES;
+    for (int i = 0; i < FDN_LINES; i++) {
+      w[i] = y[i] + x * inputSign[i];
+    }
+
+    // Increment delay position
+    v->t++;
+  }
+}
+
+// Process mono audio
+//
+// After calling this function you can
+// get wet stereo reverb signal by calling
+// FdnVerb_getLeft and FdnVerb_getRight
+void FdnVerb_process(FdnVerb* v, float in) {
+  FdnVerb_process_block(v, &in, &v->outL, &v->outR, 1);
+}
+
+// Get left channel reverb
+float FdnVerb_getLeft(FdnVerb* v) { return v->outL; }
+
+// Get right channel reverb
+float FdnVerb_getRight(FdnVerb* v) { return v->outR; }
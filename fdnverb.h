@@ -0,0 +1,34 @@
+#include <stdint.h>
+
+struct sFdnVerb;
+
+/* Get pointer to initialized FdnVerb struct */
+struct sFdnVerb* FdnVerb_create(void);
+
+/* Free resources and delete FdnVerb instance */
+void FdnVerb_delete(struct sFdnVerb* v);
+
+/* Silence the reverb for reuse, settings made so far apply without ramping */
+void FdnVerb_clear(struct sFdnVerb* v);
+
+/* Set reverb parameters (same ranges as the DattorroVerb setters) */
+void FdnVerb_setPreDelay(struct sFdnVerb* v, float value);
+void FdnVerb_setPreFilter(struct sFdnVerb* v, float value);
+void FdnVerb_setInputDiffusion1(struct sFdnVerb* v, float value);
+void FdnVerb_setInputDiffusion2(struct sFdnVerb* v, float value);
+void FdnVerb_setDecayDiffusion(struct sFdnVerb* v, float value);
+void FdnVerb_setDecay(struct sFdnVerb* v, float value);
+void FdnVerb_setDamping(struct sFdnVerb* v, float value);
+
+/* Send mono input into the delay network */
+void FdnVerb_process(struct sFdnVerb* v, float in);
+
+/* Get reverbated signal for left channel */
+float FdnVerb_getLeft(struct sFdnVerb* v);
+
+/* Get reverbated signal for right channel */
+float FdnVerb_getRight(struct sFdnVerb* v);
+
+/* Process n mono input samples into wet stereo output */
+void FdnVerb_process_block(struct sFdnVerb* v, const float* in, float* outL,
+                           float* outR, uint16_t n);
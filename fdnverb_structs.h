@@ -0,0 +1,52 @@
+#include <stdint.h>
+
+#include "smooth.h"
+
+#define FDN_LINES 8
+
+/* FdnVerb context */
+typedef struct sFdnVerb {
+  // -- Input conditioning --
+
+  // Pre-delay
+  float* preDelay;  // Delay
+  uint16_t preDelayMask;
+  uint16_t preDelayLength;
+
+  // Pre-filter
+  float preFilter;  // LPF
+
+  // Input diffusors
+  float* inDiffusion[2];  // APF
+  uint16_t inDiffusionMask[2];
+  uint16_t inDiffusionLength[2];
+
+  // -- Feedback delay network --
+
+  // Interleaved delay memory: frame k holds the sample written to every
+  // line at time k, so one network step writes FDN_LINES adjacent floats
+  float* lines;
+  uint16_t lineMask;
+  uint16_t lineLength[FDN_LINES];
+
+  // Per-line damping state and loop gain
+  float damping[FDN_LINES];  // LPF
+  SmoothedParam lineGain[FDN_LINES];
+
+  // Last stereo output, for FdnVerb_getLeft / FdnVerb_getRight
+  float outL;
+  float outR;
+
+  // -- Reverb settings, ramped at block rate --
+  SmoothedParam preFilterAmount;
+
+  SmoothedParam inputDiffusion1Amount;
+  SmoothedParam inputDiffusion2Amount;
+
+  float decayDiffusionAmount;  // Unused, the mixing matrix is fixed
+  SmoothedParam dampingAmount;
+  float decayAmount;  // lineGain[] is derived from this in FdnVerb_setDecay
+
+  // Cycle count for syncing delay lines
+  uint16_t t;
+} FdnVerb;
@@ -0,0 +1,109 @@
+/*
+Radix-2 complex FFT
+
+Iterative decimation-in-time transform on split real / imaginary arrays.
+The plan holds the bit reversal permutation and the twiddle factors of
+every stage laid out back to back, so the butterfly loop of each stage
+walks its twiddles contiguously and vectorizes. The inverse transform
+reuses the forward one by swapping the real and imaginary parts on the
+way in and out.
+*/
+
+#include "fft.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+/* FFT plan */
+typedef struct sFft {
+  uint32_t size;
+  uint32_t* bitrev;  // swap partner of each index, or itself
+  float* twiddleRe;  // stage twiddles, size / 2 + size / 4 + ... + 1
+  float* twiddleIm;
+} Fft;
+
+/* Get pointer to FFT plan for size points (power of two) */
+Fft* Fft_create(uint32_t size) {
+  uint32_t bits = 0;
+
+  if (size < 2 || (size & (size - 1))) return NULL;
+  while ((1u << bits) < size) bits++;
+
+  Fft* f = calloc(1, sizeof(Fft));
+  if (!f) return NULL;
+
+  f->size = size;
+  f->bitrev = malloc(size * sizeof(uint32_t));
+  f->twiddleRe = malloc(size * sizeof(float));
+  f->twiddleIm = malloc(size * sizeof(float));
+  if (!f->bitrev || !f->twiddleRe || !f->twiddleIm) {
+    Fft_delete(f);
+    return NULL;
+  }
+
+  for (uint32_t i = 0; i < size; i++) {
+    uint32_t r = 0;
+    for (uint32_t b = 0; b < bits; b++) r |= ((i >> b) & 1) << (bits - 1 - b);
+    f->bitrev[i] = r;
+  }
+
+  // Twiddles for butterfly span half, stored at offset half - 1
+  for (uint32_t half = 1; half < size; half <<= 1) {
+    for (uint32_t j = 0; j < half; j++) {
+      double angle = -M_PI * j / half;
+      f->twiddleRe[half - 1 + j] = cos(angle);
+      f->twiddleIm[half - 1 + j] = sin(angle);
+    }
+  }
+  return f;
+}
+
+/* Free resources and delete FFT plan */
+void Fft_delete(Fft* f) {
+  if (!f) return;
+  free(f->bitrev);
+  free(f->twiddleRe);
+  free(f->twiddleIm);
+  free(f);
+}
+
+/* In-place forward transform of split complex data, unscaled */
+void Fft_forward(Fft* f, float* re, float* im) {
+  uint32_t n = f->size;
+
+  for (uint32_t i = 0; i < n; i++) {
+    uint32_t j = f->bitrev[i];
+    if (j > i) {
+      float tr = re[i], ti = im[i];
+      re[i] = re[j];
+      im[i] = im[j];
+      re[j] = tr;
+      im[j] = ti;
+    }
+  }
+
+  for (uint32_t half = 1; half < n; half <<= 1) {
+    const float* wr = f->twiddleRe + half - 1;
+    const float* wi = f->twiddleIm + half - 1;
+    for (uint32_t base = 0; base < n; base += half << 1) {
+      float* ar = re + base;
+      float* ai = im + base;
+      float* br = ar + half;
+      float* bi = ai + half;
+      for (uint32_t j = 0; j < half; j++) {
+        float tr = br[j] * wr[j] - bi[j] * wi[j];
+        float ti = br[j] * wi[j] + bi[j] * wr[j];
+        br[j] = ar[j] - tr;
+        bi[j] = ai[j] - ti;
+        ar[j] += tr;
+        ai[j] += ti;
+      }
+    }
+  }
+}
+
+/* In-place inverse transform of split complex data, unscaled */
+void Fft_inverse(Fft* f, float* re, float* im) {
+  // ifft(x) = swap(fft(swap(x))) where swap exchanges real and imaginary
+  Fft_forward(f, im, re);
+}
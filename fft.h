@@ -0,0 +1,15 @@
+#include <stdint.h>
+
+struct sFft;
+
+/* Get pointer to FFT plan for size points (power of two) */
+struct sFft* Fft_create(uint32_t size);
+
+/* Free resources and delete FFT plan */
+void Fft_delete(struct sFft* f);
+
+/* In-place forward transform of split complex data, unscaled */
+void Fft_forward(struct sFft* f, float* re, float* im);
+
+/* In-place inverse transform of split complex data, unscaled */
+void Fft_inverse(struct sFft* f, float* re, float* im);
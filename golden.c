@@ -0,0 +1,322 @@
+// Golden-output regression harness
+//
+// Renders a fixed set of reference scenes with fixed seeds, from single
+// components (LFSaw, the unison stack, ADSR, a voice, each reverb) up to the
+// full synth, and either records them or compares them against a recording:
+//
+//   ./golden record [dir]   store the renders as float WAV files
+//   ./golden verify [dir]   compare the current build against them
+//
+// The reference renders are checked in under goldens/, recorded on a
+// known-good build, and optimized builds (fast math, fixed point, SIMD) are
+// verified against them. Each scene is compared three ways, each with its own
+// per-scene tolerance:
+// - max abs: largest sample difference
+// - spectral: worst per-frame RMS difference of the log magnitude spectra
+//   (2048 point Hann frames), in dB, over bins within 90 dB of the frame peak
+// - envelope: largest difference of the 10 ms RMS envelope, in dB, where the
+//   reference is above -80 dBFS
+// verify exits non-zero if any scene is out of tolerance.
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "fdnverb.h"
+#include "fft.h"
+#include "synth.h"
+#include "verb.h"
+#include "wav.h"
+
+#define SAMPLE_RATE 48000
+#define BLOCK 256
+#define SPECTRUM_SIZE 2048
+#define SPECTRUM_RANGE 90   // dB below the frame peak that is compared
+#define ENVELOPE_WINDOW 480  // 10 ms
+#define ENVELOPE_FLOOR 1e-4  // -80 dBFS
+
+typedef struct Tolerance {
+  double max_abs;
+  double spectral_db;
+  double envelope_db;
+} Tolerance;
+
+typedef struct GoldenScene {
+  const char *name;
+  uint16_t channels;
+  uint32_t frames;
+  void (*render)(float *left, float *right, uint32_t frames);
+  Tolerance tolerance;
+} GoldenScene;
+
+// -- Scenes --
+
+static void scene_lfsaw(float *left, float *right, uint32_t frames) {
+  LFSaw saw;
+  LFSaw_init(&saw, 220, SAMPLE_RATE, 0.5, 0.25);
+  for (uint32_t i = 0; i < frames; i++) left[i] = LFSaw_next_sample(&saw);
+}
+
+static void scene_lfsaws(float *left, float *right, uint32_t frames) {
+  LFSaws saws;
+  uint32_t random = Random_seed(1);
+  LFSaws_init(&saws, 440, SAMPLE_RATE, &random);
+  for (uint32_t i = 0; i < frames; i++) left[i] = LFSaws_next_sample(&saws);
+}
+
+static void scene_adsr(float *left, float *right, uint32_t frames) {
+  ADSR adsr;
+  ADSR_init(&adsr, 0.05, 0.1, 0.5, 0.2, 2.0, SAMPLE_RATE);
+  ADSR_gate(&adsr, true);
+  for (uint32_t i = 0; i < frames; i++) {
+    if (i % BLOCK == 0) ADSR_begin_block(&adsr, BLOCK);
+    if (i == SAMPLE_RATE * 2 / 5) ADSR_gate(&adsr, false);
+    left[i] = ADSR_process(&adsr);
+  }
+}
+
+static void scene_voice(float *left, float *right, uint32_t frames) {
+  Voice voice;
+  Voice_init(&voice, 110, 0.5, SAMPLE_RATE);
+  Voice_seed(&voice, 1);
+  Voice_gate(&voice, true);
+  memset(left, 0, frames * sizeof(float));
+  for (uint32_t i = 0; i < frames; i += BLOCK) {
+    uint16_t n = frames - i < BLOCK ? frames - i : BLOCK;
+    Voice_begin_block(&voice, n);
+    Voice_render(&voice, left + i, n, 1);
+  }
+}
+
+// impulse response with the "giant reverb" settings
+static void scene_dattorro(float *left, float *right, uint32_t frames) {
+  struct sDattorroVerb *v = DattorroVerb_create();
+  DattorroVerb_setPreDelay(v, 0.2);
+  DattorroVerb_setPreFilter(v, 0.9);
+  DattorroVerb_setInputDiffusion1(v, 0.85);
+  DattorroVerb_setInputDiffusion2(v, 0.75);
+  DattorroVerb_setDecayDiffusion(v, 0.5);
+  DattorroVerb_setDecay(v, 0.9);
+  DattorroVerb_setDamping(v, 0.4);
+  float in[BLOCK] = {1};
+  for (uint32_t i = 0; i < frames; i += BLOCK) {
+    uint16_t n = frames - i < BLOCK ? frames - i : BLOCK;
+    DattorroVerb_process_block(v, in, left + i, right + i, n);
+    in[0] = 0;
+  }
+  DattorroVerb_delete(v);
+}
+
+static void scene_fdn(float *left, float *right, uint32_t frames) {
+  struct sFdnVerb *v = FdnVerb_create();
+  FdnVerb_setPreDelay(v, 0.2);
+  FdnVerb_setPreFilter(v, 0.9);
+  FdnVerb_setInputDiffusion1(v, 0.85);
+  FdnVerb_setInputDiffusion2(v, 0.75);
+  FdnVerb_setDecayDiffusion(v, 0.5);
+  FdnVerb_setDecay(v, 0.9);
+  FdnVerb_setDamping(v, 0.4);
+  float in[BLOCK] = {1};
+  for (uint32_t i = 0; i < frames; i += BLOCK) {
+    uint16_t n = frames - i < BLOCK ? frames - i : BLOCK;
+    FdnVerb_process_block(v, in, left + i, right + i, n);
+    in[0] = 0;
+  }
+  FdnVerb_delete(v);
+}
+
+// the main.c drone, shortened, through the build's reverb
+static void scene_synth(float *left, float *right, uint32_t frames) {
+  static const float freqs[3] = {220, 275, 55};
+  static const float amps[3] = {0.75, 0.5, 0.25};
+  Synth *s = Synth_create(3, SAMPLE_RATE);
+  Synth_set_giant_reverb(s);
+  Synth_reset(s, 1);
+  for (int i = 0; i < 3; i++) {
+    Voice_set_release(&s->voices[i], 0.1);
+    Event on = {.time = 0,
+                .type = event_note_on,
+                .voice = i,
+                .value = freqs[i],
+                .amp = amps[i]};
+    Event off = {.time = frames / 2, .type = event_note_off, .voice = i};
+    Synth_post(s, &on);
+    Synth_post(s, &off);
+  }
+  for (uint32_t i = 0; i < frames; i += BLOCK) {
+    uint16_t n = frames - i < BLOCK ? frames - i : BLOCK;
+    Synth_render(s, left + i, right + i, n);
+  }
+  Synth_delete(s);
+}
+
+static const GoldenScene scenes[] = {
+    {"lfsaw", 1, SAMPLE_RATE / 2, scene_lfsaw, {1e-5, 0.05, 0.01}},
+    {"lfsaws", 1, SAMPLE_RATE / 2, scene_lfsaws, {1e-4, 0.1, 0.05}},
+    {"adsr", 1, SAMPLE_RATE * 3 / 4, scene_adsr, {1e-4, 0.1, 0.05}},
+    {"voice", 1, SAMPLE_RATE, scene_voice, {1e-3, 0.5, 0.1}},
+    {"dattorro", 2, SAMPLE_RATE * 2, scene_dattorro, {1e-4, 0.2, 0.1}},
+    {"fdn", 2, SAMPLE_RATE * 2, scene_fdn, {1e-4, 0.2, 0.1}},
+    {"synth", 2, SAMPLE_RATE * 2, scene_synth, {1e-2, 1.0, 0.5}},
+};
+
+// -- Comparisons --
+
+static double max_abs(const float *a, const float *b, uint32_t n) {
+  double worst = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    double d = fabs((double)a[i] - (double)b[i]);
+    if (d > worst) worst = d;
+  }
+  return worst;
+}
+
+static void log_spectrum(struct sFft *fft, const float *x, double *db) {
+  static float re[SPECTRUM_SIZE], im[SPECTRUM_SIZE];
+  for (int i = 0; i < SPECTRUM_SIZE; i++) {
+    float hann = 0.5f - 0.5f * cosf(2 * (float)M_PI * i / SPECTRUM_SIZE);
+    re[i] = x[i] * hann;
+    im[i] = 0;
+  }
+  Fft_forward(fft, re, im);
+  for (int i = 0; i <= SPECTRUM_SIZE / 2; i++) {
+    double power =
+        (double)re[i] * (double)re[i] + (double)im[i] * (double)im[i];
+    db[i] = 10 * log10(power + 1e-30);
+  }
+}
+
+static double spectral_db(const float *ref, const float *x, uint32_t n) {
+  struct sFft *fft = Fft_create(SPECTRUM_SIZE);
+  double a[SPECTRUM_SIZE / 2 + 1], b[SPECTRUM_SIZE / 2 + 1];
+  double worst = 0;
+  for (uint32_t start = 0; start + SPECTRUM_SIZE <= n;
+       start += SPECTRUM_SIZE / 2) {
+    log_spectrum(fft, ref + start, a);
+    log_spectrum(fft, x + start, b);
+    double peak = -1e30;
+    for (int i = 0; i <= SPECTRUM_SIZE / 2; i++) {
+      if (a[i] > peak) peak = a[i];
+    }
+    double sum = 0;
+    int bins = 0;
+    for (int i = 0; i <= SPECTRUM_SIZE / 2; i++) {
+      if (a[i] < peak - SPECTRUM_RANGE) continue;
+      sum += (a[i] - b[i]) * (a[i] - b[i]);
+      bins++;
+    }
+    // skip silent frames
+    if (bins && peak > -200) {
+      double rms = sqrt(sum / bins);
+      if (rms > worst) worst = rms;
+    }
+  }
+  Fft_delete(fft);
+  return worst;
+}
+
+static double envelope_db(const float *ref, const float *x, uint32_t n) {
+  double worst = 0;
+  for (uint32_t start = 0; start + ENVELOPE_WINDOW <= n;
+       start += ENVELOPE_WINDOW) {
+    double a = 0, b = 0;
+    for (int i = 0; i < ENVELOPE_WINDOW; i++) {
+      a += (double)ref[start + i] * (double)ref[start + i];
+      b += (double)x[start + i] * (double)x[start + i];
+    }
+    a = sqrt(a / ENVELOPE_WINDOW);
+    b = sqrt(b / ENVELOPE_WINDOW);
+    if (a < ENVELOPE_FLOOR) continue;
+    double d = fabs(20 * log10(a / (b + 1e-30)));
+    if (d > worst) worst = d;
+  }
+  return worst;
+}
+
+// -- Record / verify --
+
+static void scene_path(char *path, size_t size, const char *dir,
+                       const GoldenScene *scene) {
+  snprintf(path, size, "%s/%s.wav", dir, scene->name);
+}
+
+static bool record(const GoldenScene *scene, const char *dir, float *left,
+                   float *right) {
+  char path[512];
+  scene_path(path, sizeof(path), dir, scene);
+  struct sWavWriter *w =
+      WavWriter_create(scene->channels, SAMPLE_RATE, WAV_FLOAT32, false);
+  bool ok = w && WavWriter_open(w, path) &&
+            WavWriter_write(w, left, right, scene->frames) &&
+            WavWriter_close(w);
+  if (w) WavWriter_delete(w);
+  printf("%-10s %s\n", scene->name, ok ? path : "could not write");
+  return ok;
+}
+
+static bool verify(const GoldenScene *scene, const char *dir, float *left,
+                   float *right) {
+  char path[512];
+  scene_path(path, sizeof(path), dir, scene);
+  uint16_t channels;
+  uint32_t sample_rate, frames;
+  float *golden = Wav_read(path, &channels, &sample_rate, &frames);
+  if (!golden || channels != scene->channels || frames != scene->frames) {
+    printf("%-10s missing or different layout: %s\n", scene->name, path);
+    free(golden);
+    return false;
+  }
+
+  const Tolerance *t = &scene->tolerance;
+  double abs = 0, spectral = 0, envelope = 0;
+  float *ref = malloc(frames * sizeof(float));
+  for (int c = 0; c < channels; c++) {
+    const float *x = c ? right : left;
+    for (uint32_t i = 0; i < frames; i++) ref[i] = golden[i * channels + c];
+    abs = fmax(abs, max_abs(ref, x, frames));
+    spectral = fmax(spectral, spectral_db(ref, x, frames));
+    envelope = fmax(envelope, envelope_db(ref, x, frames));
+  }
+  free(ref);
+  free(golden);
+
+  bool ok = abs <= t->max_abs && spectral <= t->spectral_db &&
+            envelope <= t->envelope_db;
+  printf("%-10s %12.3g %12.4f %12.4f   %s\n", scene->name, abs, spectral,
+         envelope, ok ? "ok" : "FAIL");
+  return ok;
+}
+
+int main(int argc, char *argv[]) {
+  bool recording = argc > 1 && !strcmp(argv[1], "record");
+  if (argc < 2 || (!recording && strcmp(argv[1], "verify"))) {
+    fprintf(stderr, "usage: %s record|verify [dir]\n", argv[0]);
+    return 2;
+  }
+  const char *dir = argc > 2 ? argv[2] : "goldens";
+  if (recording) mkdir(dir, 0755);
+
+  // nothing may depend on the time of day
+  srand(1);
+
+  if (!recording) {
+    printf("%-10s %12s %12s %12s\n", "scene", "max abs", "spectral dB",
+           "envelope dB");
+  }
+  int failures = 0;
+  for (size_t i = 0; i < sizeof(scenes) / sizeof(scenes[0]); i++) {
+    const GoldenScene *scene = &scenes[i];
+    float *left = calloc(scene->frames, sizeof(float));
+    float *right = calloc(scene->frames, sizeof(float));
+    scene->render(left, right, scene->frames);
+    bool ok = recording ? record(scene, dir, left, right)
+                        : verify(scene, dir, left, right);
+    if (!ok) failures++;
+    free(left);
+    free(right);
+  }
+  return failures ? 1 : 0;
+}
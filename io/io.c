@@ -32,6 +32,14 @@
 clock clk[2];
 divider pulseout1_divider, pulseout2_divider, cvout1_divider, cvout2_divider,
     tm_divider, bg_divider;
+// External clock on each pulse input, steering clk[]
+tempo_estimator tempo[2];
+
+// Flash work for saves pauses the audio core for each operation (see
+// PresetFlashBegin), so it only runs after this much silence. There is no
+// deadline: a save waits for as long as the audio plays, and is lost if the
+// power goes first.
+#define PRESET_QUIET_SAMPLES 4800  // 100ms
 
 int main() {
   stdio_init_all();
@@ -44,6 +52,8 @@ int main() {
 
   sleep_ms(50);
   SetupComputerIO();
+  SetupPresetStore();
+  int calibrationFailed = ReadEEPROM();
 
   clock_init(&clk[0]);
   clock_init(&clk[1]);
@@ -53,11 +63,51 @@ int main() {
   divider_init(&cvout2_divider);
   divider_init(&tm_divider);
   divider_init(&bg_divider);
+  tempo_estimator_init(&tempo[0]);
+  tempo_estimator_init(&tempo[1]);
 
   multicore_launch_core1(audio_worker);
+  uint64_t audioStart = time_us_64();
 
+  printf("calibration %s in %lu us, audio started %llu us after boot\n",
+         calibrationFailed      ? "defaults"
+         : calibrationFromFlash ? "from flash copy"
+                                : "loaded",
+         eepromReadMicros, audioStart);
+  uint32_t knobChanges = 0;
+  uint32_t lastReport = time_us_32();
   while (true) {
+    // Follow the pulse inputs, a millisecond of latency is only a phase
+    // offset that tempo_estimator_sync_clock winds back out
+    for (int i = 0; i < 2; i++) {
+      uint32_t pulseTime;
+      while (pulse_ring_pop(&pulseRings[i], &pulseTime)) {
+        if (tempo_estimator_pulse(&tempo[i], pulseTime)) {
+          tempo_estimator_sync_clock(&tempo[i], &clk[i], time_us_32());
+        }
+      }
+    }
+
+    // At most one erase or page program per millisecond, all in silence
+    if (quietSamples >= PRESET_QUIET_SAMPLES) preset_store_step(&presets);
+
+    sleep_ms(1);
+    if (time_us_32() - lastReport < 1000000) continue;
+    lastReport = time_us_32();
+
+    if (knobs.changes != knobChanges) {
+      knobChanges = knobs.changes;
+      printf("knobs: main %u x %u y %u switch %u\n", knobs.value[KNOB_MAIN],
+             knobs.value[KNOB_X], knobs.value[KNOB_Y],
+             knobs.value[KNOB_SWITCH]);
+    }
+    printf("audio jobs: %lu run, %lu overruns\n", jobs.runs, jobs.overruns);
+    for (int i = 0; i < 2; i++) {
+      if (tempo[i].locked) {
+        printf("pulse %d: period %lu us, dropped %lu\n", i + 1,
+               tempo[i].period >> 8, pulseRings[i].dropped);
+      }
+    }
     printf("ok\n");
-    sleep_ms(1000);
   }
 }
@@ -1,4 +1,7 @@
 
+#include "knobs.h"
+#include "scheduler.h"
+
 ////////////////////////////////////////
 // Audio core functions
 void process_sample();
@@ -10,6 +13,47 @@ void process_sample();
 #define RUN_ADC_MODE_ADC_STOPPED 2
 #define RUN_ADC_MODE_REQUEST_ADC_RESTART 3
 volatile uint8_t runADCMode = RUN_ADC_MODE_RUNNING;
+
+// Preset store flash callbacks, called from core 0. Each erase or program
+// stalls XIP, so the audio core is parked for it: the ADC is stopped at a
+// sample boundary, so its round robin restarts in step with the DMA, and
+// the audio core is then locked out, spinning in RAM with its interrupts
+// off, until the operation is done. Audio pauses for the operation, up to
+// tens of ms for an erase, so io.c only runs them in a quiet gap.
+void PresetFlashBegin() {
+  runADCMode = RUN_ADC_MODE_REQUEST_ADC_STOP;
+  while (runADCMode != RUN_ADC_MODE_ADC_STOPPED) tight_loop_contents();
+  multicore_lockout_start_blocking();
+}
+
+void PresetFlashEnd() {
+  multicore_lockout_end_blocking();
+  runADCMode = RUN_ADC_MODE_REQUEST_ADC_RESTART;
+}
+
+void PresetFlashErase(uint32_t offset) {
+  PresetFlashBegin();
+  uint32_t ints = save_and_disable_interrupts();
+  flash_range_erase(PRESET_FLASH_OFFSET + offset, PRESET_SECTOR_SIZE);
+  restore_interrupts(ints);
+  PresetFlashEnd();
+}
+
+void PresetFlashProgram(uint32_t offset, const uint8_t *page) {
+  PresetFlashBegin();
+  uint32_t ints = save_and_disable_interrupts();
+  flash_range_program(PRESET_FLASH_OFFSET + offset, page, PRESET_PAGE_SIZE);
+  restore_interrupts(ints);
+  PresetFlashEnd();
+}
+
+// Before ReadEEPROM, which keeps its calibration copy here. Mounting only
+// reads flash, the callbacks are used once the audio core is running.
+void SetupPresetStore() {
+  preset_flash flash = {(const uint8_t *)(XIP_BASE + PRESET_FLASH_OFFSET),
+                        PresetFlashErase, PresetFlashProgram};
+  preset_store_mount(&presets, flash);
+}
 // Buffers that DMA reads into / out of
 uint16_t ADC_Buffer[2][8];
 uint16_t SPI_Buffer[2][2];
@@ -17,6 +61,15 @@ uint8_t adc_dma, spi_dma;  // DMA ids
 uint8_t dmaPhase = 0;
 volatile int16_t dacOutL = 0, dacOutR = 0;
 volatile int16_t adcInL = 0x800, adcInR = 0x800;
+// Knob values, scanned by the ISR and read by either core
+knob_scanner knobs;
+// Consecutive samples with both outputs within QUIET_LEVEL of zero, so
+// flash work can wait for a gap in the audio
+#define QUIET_LEVEL 8
+volatile uint32_t quietSamples = 0;
+// Work posted by buffer_full, run by the audio core between samples
+scheduler jobs;
+#define JOB_KNOBS 0
 
 // Convert signed int16 value into data string for DAC output
 uint16_t __not_in_flash_func(dacval)(int16_t value, uint16_t dacChannel) {
@@ -28,8 +81,6 @@ uint16_t __not_in_flash_func(dacval)(int16_t value, uint16_t dacChannel) {
 // from all four inputs
 void __not_in_flash_func(buffer_full)() {
   debug_pin(DEBUG_2, true);
-  static int mux_state = 0;
-  static int norm_probe_count = 0;
   static int np = 0, np1 = 0, np2 = 0;
 
   adc_select_input(0);
@@ -52,12 +103,28 @@ void __not_in_flash_func(buffer_full)() {
 
   adcInL = ((ADC_Buffer[cpuPhase][1] + ADC_Buffer[cpuPhase][5]) - 0x1000) >> 1;
 
+  // Knobs, from MUX_IO_1, moving the mux on every few samples
+  if (knob_scanner_sample(&knobs, ADC_Buffer[cpuPhase][2],
+                          ADC_Buffer[cpuPhase][6])) {
+    gpio_put(MX_A, knobs.position & 1);
+    gpio_put(MX_B, (knobs.position >> 1) & 1);
+    scheduler_post(&jobs, JOB_KNOBS);
+  }
+
   ////////////////////////////////////////
   // Run the DSP
   process_sample();
   SPI_Buffer[cpuPhase][0] = dacval(dacOutL, DAC_CHANNEL_A);
   SPI_Buffer[cpuPhase][1] = dacval(dacOutR, DAC_CHANNEL_B);
 
+  int16_t outL = dacOutL, outR = dacOutR;
+  if (outL < QUIET_LEVEL && outL > -QUIET_LEVEL && outR < QUIET_LEVEL &&
+      outR > -QUIET_LEVEL) {
+    quietSamples++;
+  } else {
+    quietSamples = 0;
+  }
+
   // Indicate to usb core that we've finished running this sample.
   if (runADCMode == RUN_ADC_MODE_REQUEST_ADC_STOP) {
     adc_run(false);
@@ -68,6 +135,8 @@ void __not_in_flash_func(buffer_full)() {
   }
 }
 
+void __not_in_flash_func(update_knobs)() { knob_scanner_update(&knobs); }
+
 // Main audio core function
 void __not_in_flash_func(audio_worker)() {
   // Audio worker must be able to stop when USB worker wants to write to flash
@@ -76,6 +145,12 @@ void __not_in_flash_func(audio_worker)() {
   adc_select_input(0);
   adc_set_round_robin(0b0001111U);
 
+  knob_scanner_init(&knobs);
+  scheduler_init(&jobs);
+  scheduler_add(&jobs, JOB_KNOBS, update_knobs);
+  gpio_put(MX_A, 0);
+  gpio_put(MX_B, 0);
+
   // enabled, with DMA request when FIFO contains data, no erro flag, no byte
   // shift
   adc_fifo_setup(true, true, 1, false, false);
@@ -142,6 +217,19 @@ void __not_in_flash_func(audio_worker)() {
       adc_set_round_robin(0b0001111U);
       adc_run(true);
     }
+
+    // Take the posted jobs, or sleep until the next interrupt if there are
+    // none. WFI wakes on an interrupt that is pending while masked, so a
+    // post that lands after the check is not missed, and the ISR runs as
+    // soon as interrupts are restored. While the ADC is stopped there are
+    // no sample interrupts, so keep polling for the restart instead.
+    uint32_t ints = save_and_disable_interrupts();
+    uint32_t taken = jobs.pending;
+    jobs.pending = 0;
+    if (!taken && runADCMode == RUN_ADC_MODE_RUNNING) __wfi();
+    restore_interrupts(ints);
+
+    scheduler_run(&jobs, taken);
   }
 }
 
@@ -55,5 +55,62 @@ bool __not_in_flash_func(clock_state)(clock *c)
 	return c->count & 0x80000000;
 }
 
+// Number of samples until the next edge: clock_tick will return true on
+// the n-th call from now. The edge is where count next crosses a multiple
+// of 2^31, so this is exact for increments below 2^31 (frequencies below
+// 24kHz). Returns UINT32_MAX for a stopped clock.
+// The M0+ has no divide instruction and the library divide runs from
+// flash, so the rounded up quotient is found by long division, one step
+// per bit of the result.
+uint32_t __not_in_flash_func(clock_samples_to_edge)(clock *c)
+{
+	uint32_t increment = c->increment;
+	if (increment == 0) return UINT32_MAX;
+	uint32_t rest = 0x7FFFFFFF - (c->count & 0x7FFFFFFF);
+	uint32_t step = increment, n = 0;
+	int shift = 0;
+	while (step <= rest >> 1)
+	{
+		step <<= 1;
+		shift++;
+	}
+	for (; shift >= 0; shift--)
+	{
+		n <<= 1;
+		if (rest >= step)
+		{
+			rest -= step;
+			n |= 1;
+		}
+		step >>= 1;
+	}
+	// (remaining - 1) / increment + 1, remaining = 2^31 - count % 2^31
+	return n + 1;
+}
+
+// Advance the clock by n samples at once, ending where n calls to
+// clock_tick would. The offset within the block (0 = first sample) of each
+// edge, or of each rising edge only if rising_only, is written to edges, up
+// to max of them, and the number written is returned. The cost is one
+// clock_samples_to_edge per edge, independent of n.
+uint8_t __not_in_flash_func(clock_advance)(clock *c, uint32_t n,
+                                           uint16_t *edges, uint8_t max,
+                                           bool rising_only)
+{
+	uint8_t found = 0;
+	uint32_t pos = 0;
+	for (;;)
+	{
+		uint32_t next = clock_samples_to_edge(c);
+		if (next > n - pos) break;
+		pos += next;
+		c->count += next * c->increment;
+		if (found < max && (!rising_only || clock_state(c)))
+			edges[found++] = pos - 1;
+	}
+	c->count += (n - pos) * c->increment;
+	return found;
+}
+
 
 #endif
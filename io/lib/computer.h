@@ -78,15 +78,14 @@ uint8_t GetBoardID() {
   return pd | pu;
 }
 
-#define EEPROM_ADDR_ID 0
-#define EEPROM_ADDR_VERSION 2
-#define EEPROM_ADDR_CRC_L 87
-#define EEPROM_ADDR_CRC_H 86
-#define EEPROM_VAL_ID 2001
-#define EEPROM_NUM_BYTES 88
-
-#define CAL_MAX_CHANNELS 2
-#define CAL_MAX_POINTS 10
+#include "calibration.h"
+#include "notetable.h"
+#include "presets.h"
+#include "pulsein.h"
+
+// 24LC-series EEPROMs run I2C fast mode
+#define EEPROM_I2C_HZ (400 * 1000)
+
 uint8_t eepromPageAddress = 0x50;
 
 typedef struct {
@@ -94,55 +93,42 @@ typedef struct {
   int32_t mi, bi;
 } CalCoeffs;
 
-typedef struct {
-  int32_t dacSetting;
-  int8_t voltage;
-} CalPoint;
-
 uint8_t numCalibrationPoints[CAL_MAX_CHANNELS];
 CalPoint calibrationTable[CAL_MAX_CHANNELS][CAL_MAX_POINTS];
 CalCoeffs calCoeffs[CAL_MAX_CHANNELS];
-
-// Read a byte from EEPROM
-uint8_t ReadByteFromEEPROM(unsigned int eeAddress) {
+// DAC setting per note, built from calCoeffs by CalcCalCoeffs
+note_table noteTables[CAL_MAX_CHANNELS];
+// Time taken by the last ReadEEPROM, for the boot report
+uint32_t eepromReadMicros;
+// Pulse timestamps from PULSE_1_INPUT and PULSE_2_INPUT
+pulse_ring pulseRings[2];
+
+// Presets and calibration, in the last PRESET_SECTORS sectors of flash.
+// Mounted by SetupPresetStore, in audio_worker.h with the flash callbacks.
+#define PRESET_FLASH_OFFSET \
+  (PICO_FLASH_SIZE_BYTES - PRESET_SECTORS * PRESET_SECTOR_SIZE)
+preset_store presets;
+// Set by ReadEEPROM when the EEPROM was unusable and the copy was used
+bool calibrationFromFlash;
+
+// Read length bytes from EEPROM in one sequential read: the address write
+// ends with a repeated start instead of a stop, and the part then streams
+// consecutive bytes. Returns false if the part did not acknowledge.
+bool ReadBlockFromEEPROM(unsigned int eeAddress, uint8_t *data, int length) {
   uint8_t deviceAddress = eepromPageAddress | ((eeAddress >> 8) & 0x0F);
-  uint8_t data = 0xFF;
-
   uint8_t addr_low_byte = eeAddress & 0xFF;
-  i2c_write_blocking(i2c0, deviceAddress, &addr_low_byte, 1, false);
-
-  i2c_read_blocking(i2c0, deviceAddress, &data, 1, false);
-  return data;
-}
-
-// Read a 16-bit integer from EEPROM
-int ReadIntFromEEPROM(unsigned int eeAddress) {
-  uint8_t highByte = ReadByteFromEEPROM(eeAddress);
-  uint8_t lowByte = ReadByteFromEEPROM(eeAddress + 1);
-  return (highByte << 8) | lowByte;
-}
-
-uint16_t CRCencode(const uint8_t *data, int length) {
-  uint16_t crc = 0xFFFF;  // Initial CRC value
-  for (int i = 0; i < length; i++) {
-    crc ^= ((uint16_t)data[i]) << 8;  // Bring in the next byte
-    for (uint8_t bit = 0; bit < 8; bit++) {
-      if (crc & 0x8000) {
-        crc = (crc << 1) ^ 0x1021;  // CRC-CCITT polynomial
-      } else {
-        crc = crc << 1;
-      }
-    }
+  if (i2c_write_blocking(i2c0, deviceAddress, &addr_low_byte, 1, true) != 1) {
+    return false;
   }
-  return crc;
+  return i2c_read_blocking(i2c0, deviceAddress, data, length, false) == length;
 }
 
+// Notes outside 0..127 are clamped to the ends of the table. For bends and
+// glides use note_table_lookup on noteTables directly.
 uint32_t midiToDac(int midiNote, int channel) {
-  int32_t dacValue =
-      ((calCoeffs[channel].mi * (midiNote - 60)) >> 4) + calCoeffs[channel].bi;
-  if (dacValue > 524287) dacValue = 524287;
-  if (dacValue < 0) dacValue = 0;
-  return dacValue;
+  if (midiNote < 0) midiNote = 0;
+  if (midiNote >= NOTE_TABLE_NOTES) midiNote = NOTE_TABLE_NOTES - 1;
+  return noteTables[channel].dac[midiNote];
 }
 
 void CalcCalCoeffs(int channel) {
@@ -171,72 +157,67 @@ void CalcCalCoeffs(int channel) {
 
   calCoeffs[channel].mi = (calCoeffs[channel].m * 1.333333333333333f + 0.5f);
   calCoeffs[channel].bi = calCoeffs[channel].b + 0.5f;
+  note_table_build(&noteTables[channel], calCoeffs[channel].mi,
+                   calCoeffs[channel].bi);
   debug("%d %f %f\n", channel, calCoeffs[channel].m, calCoeffs[channel].b);
 }
 
 int ReadEEPROM() {
-  // Set up default values in the calibration table,
-  // to be used if EEPROM read fails
-  calibrationTable[0][0].voltage = -20;  // -2V
-  calibrationTable[0][0].dacSetting = 347700;
-  calibrationTable[0][1].voltage = 0;  // 0V
-  calibrationTable[0][1].dacSetting = 261200;
-  calibrationTable[0][2].voltage = 20;  // +2V
-  calibrationTable[0][2].dacSetting = 174400;
-
-  calibrationTable[1][0].voltage = -20;  // -2V
-  calibrationTable[1][0].dacSetting = 347700;
-  calibrationTable[1][1].voltage = 0;  // 0V
-  calibrationTable[1][1].dacSetting = 261200;
-  calibrationTable[1][2].voltage = 20;  // +2V
-  calibrationTable[1][2].dacSetting = 174400;
-
-  if (ReadIntFromEEPROM(EEPROM_ADDR_ID) != EEPROM_VAL_ID) {
-    debugp("Failed to read EEPROM ID\n");
-    return 1;
+  // Set up default values in the calibration table, to be used if the
+  // EEPROM read fails. CalibrationParse only writes a valid image over them.
+  for (int channel = 0; channel < CAL_MAX_CHANNELS; channel++) {
+    numCalibrationPoints[channel] = 3;
+    calibrationTable[channel][0].voltage = -20;  // -2V
+    calibrationTable[channel][0].dacSetting = 347700;
+    calibrationTable[channel][1].voltage = 0;  // 0V
+    calibrationTable[channel][1].dacSetting = 261200;
+    calibrationTable[channel][2].voltage = 20;  // +2V
+    calibrationTable[channel][2].dacSetting = 174400;
   }
+
+  uint64_t start = time_us_64();
   uint8_t buf[EEPROM_NUM_BYTES];
-  for (int i = 0; i < EEPROM_NUM_BYTES; i++) {
-    buf[i] = ReadByteFromEEPROM(i);
+  bool read = ReadBlockFromEEPROM(0, buf, EEPROM_NUM_BYTES);
+  int result = read ? CalibrationParse(buf, numCalibrationPoints,
+                                       calibrationTable)
+                    : CAL_BAD_ID;
+  eepromReadMicros = time_us_64() - start;
+
+  // Keep a copy of a good image in the preset store, and fall back to it
+  // when the EEPROM is missing or corrupt. The store must be mounted.
+  uint8_t copy[EEPROM_NUM_BYTES];
+  bool haveCopy = preset_store_load(&presets, PRESET_KEY_CALIBRATION, copy,
+                                    EEPROM_NUM_BYTES) == EEPROM_NUM_BYTES;
+  calibrationFromFlash = false;
+  if (result == CAL_OK) {
+    if (!haveCopy || memcmp(copy, buf, EEPROM_NUM_BYTES)) {
+      preset_store_save(&presets, PRESET_KEY_CALIBRATION, buf,
+                        EEPROM_NUM_BYTES);
+    }
+  } else if (haveCopy && CalibrationParse(copy, numCalibrationPoints,
+                                          calibrationTable) == CAL_OK) {
+    debugp("Using the calibration copy from flash\n");
+    memcpy(buf, copy, EEPROM_NUM_BYTES);
+    result = CAL_OK;
+    calibrationFromFlash = true;
   }
 
-  {
-    int eepMajor = (buf[EEPROM_ADDR_VERSION] >> 4) & 0x0F;  // Extract bits 7-4
-    int eepMinor = (buf[EEPROM_ADDR_VERSION] >> 2) & 0x03;  // Extract bits 3-2
-    int eepPoint = buf[EEPROM_ADDR_VERSION] & 0x03;         // Extract bits 1-0
+  if (result == CAL_BAD_ID) {
+    debugp("Failed to read EEPROM ID\n");
+  } else {
+    int eepMajor, eepMinor, eepPoint;
+    CalibrationVersion(buf, &eepMajor, &eepMinor, &eepPoint);
     debug("EEPROM version %d.%d.%d\n", eepMajor, eepMinor, eepPoint);
   }
-
-  uint16_t calculatedCRC = CRCencode(buf, 86);
-  uint16_t foundCRC =
-      ((uint16_t)buf[EEPROM_ADDR_CRC_H] << 8) | buf[EEPROM_ADDR_CRC_L];
-
-  if (calculatedCRC != foundCRC) {
+  if (result == CAL_BAD_CRC) {
     debugp("EEPROM CRC check failed\n");
-    return 1;
+  }
+  if (result == CAL_BAD_POINTS) {
+    debugp("EEPROM calibration point count out of range\n");
   }
 
-  int bufferIndex = 4;
-
+  // On every path, so that midiToDac has a table even with the defaults
   for (uint8_t channel = 0; channel < CAL_MAX_CHANNELS; channel++) {
-    int channelOffset =
-        bufferIndex + (41 * channel);  // channel 0 = 4, channel 1 = 45
-    numCalibrationPoints[channel] = buf[channelOffset++];
-    for (uint8_t point = 0; point < numCalibrationPoints[channel]; point++) {
-      // Unpack Pack targetVoltage (int8_t) from buf
-      int8_t targetVoltage = (int8_t)buf[channelOffset++];
-
-      // Unack dacSetting (uint32_t) from buf (4 bytes)
-      uint32_t dacSetting = 0;
-      dacSetting |= ((uint32_t)buf[channelOffset++]) << 24;  // MSB
-      dacSetting |= ((uint32_t)buf[channelOffset++]) << 16;
-      dacSetting |= ((uint32_t)buf[channelOffset++]) << 8;
-      dacSetting |= ((uint32_t)buf[channelOffset++]);  // LSB
-
-      // Write settings into calibration table
-      calibrationTable[channel][point].voltage = targetVoltage;
-      calibrationTable[channel][point].dacSetting = dacSetting;
-    }
     CalcCalCoeffs(channel);
   }
   for (uint8_t channel = 0; channel < CAL_MAX_CHANNELS; channel++) {
@@ -246,7 +227,12 @@ int ReadEEPROM() {
             calibrationTable[channel][point].dacSetting);
     }
   }
-  return 0;
+  return result != CAL_OK;
+}
+
+// Timestamp pulses into pulseRings, nothing else
+void __not_in_flash_func(pulse_input_irq)(uint gpio, uint32_t events) {
+  pulse_ring_push(&pulseRings[gpio == PULSE_2_INPUT], time_us_32());
 }
 
 void SetupComputerIO() {
@@ -300,6 +286,14 @@ void SetupComputerIO() {
   gpio_pull_up(
       PULSE_2_INPUT);  // NB: Needs pullup to activate transistor on inputs
 
+  // The inputs are inverted by the transistor, so a pulse starts on the
+  // falling edge of the pin. The interrupt runs on the calling core.
+  pulse_ring_init(&pulseRings[0]);
+  pulse_ring_init(&pulseRings[1]);
+  gpio_set_irq_enabled_with_callback(PULSE_1_INPUT, GPIO_IRQ_EDGE_FALL, true,
+                                     &pulse_input_irq);
+  gpio_set_irq_enabled(PULSE_2_INPUT, GPIO_IRQ_EDGE_FALL, true);
+
   // Setup SPI for DAC output
   spi_init(SPI_PORT, 15625000);
   spi_set_format(SPI_PORT, 16, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
@@ -308,7 +302,7 @@ void SetupComputerIO() {
   gpio_set_function(DAC_CS, GPIO_FUNC_SPI);
 
   // Setup I2C for EEPROM
-  i2c_init(i2c0, 100 * 1000);
+  i2c_init(i2c0, EEPROM_I2C_HZ);
   gpio_set_function(EEPROM_SDA, GPIO_FUNC_I2C);
   gpio_set_function(EEPROM_SCL, GPIO_FUNC_I2C);
 
@@ -45,4 +45,29 @@ void __not_in_flash_func(divider_set)(divider *d, uint8_t divisor) {
 }
 
 void divider_init(divider *d) { divider_set(d, 1); }
+
+// Block version of divider_step for rising edges: given the offsets of a
+// block's rising clock edges (from clock_advance), keeps in place the ones
+// on which divider_step(d, true) would return true, and returns how many
+// are left. Jumps from trigger to trigger instead of visiting every edge,
+// and needs no division, which the M0+ would do in a library call.
+uint8_t __not_in_flash_func(divider_filter)(divider *d, uint16_t *edges,
+                                            uint8_t count) {
+  // divisor 0 is allowed by divider_set, where divider_step's 8-bit counter
+  // wraps and triggers every 256th edge
+  uint32_t period = d->divisor ? d->divisor : 256;
+  uint32_t i = period - d->counter - 1;
+  if (i >= count) {
+    d->counter += count;
+    return 0;
+  }
+  uint8_t kept = 0;
+  uint32_t last = i;
+  for (; i < count; i += period) {
+    edges[kept++] = edges[i];
+    last = i;
+  }
+  d->counter = count - 1 - last;
+  return kept;
+}
 #endif
@@ -0,0 +1,104 @@
+#ifndef KNOBS_H
+#define KNOBS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef __not_in_flash_func
+#define __not_in_flash_func(f) f  // host builds
+#endif
+
+////////////////////////////////////////
+// Control-rate knob scanner
+//
+// Called from the per-sample ISR with the two MUX_IO_1 readings of the
+// sample. The mux stays on each knob for KNOB_SCAN_SAMPLES samples; the
+// first KNOB_SETTLE_SAMPLES are discarded while the mux output settles and
+// the rest are summed into one reading per visit (every knob is visited
+// at 48kHz / 40 = 1.2kHz). Two ADC values a sample over 8 samples is 16
+// values, so the sum is already the mean in 12-bit << 4 and no division is
+// needed, which on the M0+ would be a library call. That is all the ISR
+// does. knob_scanner_update,
+// run outside the ISR, takes each new reading through a one-pole low pass,
+// and the result is only published when it moves more than
+// KNOB_HYSTERESIS from the last published value, so a resting knob does
+// not jitter.
+//
+// Published values are aligned 16-bit stores, which the main core can read
+// at any time without locking; changes counts publications so it can tell
+// when to look.
+
+#define KNOB_COUNT 4          // KNOB_MAIN, KNOB_X, KNOB_Y, KNOB_SWITCH
+#define KNOB_SCAN_SAMPLES 10  // samples spent on each mux position
+#define KNOB_SETTLE_SAMPLES 2 // first samples after a mux change, ignored
+#define KNOB_FILTER_SHIFT 2   // low pass: y += (x - y) >> shift, per visit
+#define KNOB_HYSTERESIS 8     // 12-bit ADC counts
+
+#if 2 * (KNOB_SCAN_SAMPLES - KNOB_SETTLE_SAMPLES) != 16
+#error "knob_scanner_update expects 16 ADC values per visit"
+#endif
+
+typedef struct {
+  uint8_t position;  // mux position, which is also the knob index
+  uint8_t count;     // samples spent on this position so far
+  uint16_t sum;      // readings summed this visit, 16 at most 4095
+  volatile uint16_t reading[KNOB_COUNT];  // sum of the last visit
+  volatile uint8_t visits[KNOB_COUNT];    // bumped on every new reading
+  uint8_t seen[KNOB_COUNT];               // visits already filtered
+  int32_t filtered[KNOB_COUNT];           // low passed, 12-bit << 4
+  volatile uint16_t value[KNOB_COUNT];  // published, 0..4095
+  volatile uint32_t changes;            // bumped on every publication
+} knob_scanner;
+
+void knob_scanner_init(knob_scanner *k) {
+  k->position = 0;
+  k->count = 0;
+  k->sum = 0;
+  for (int i = 0; i < KNOB_COUNT; i++) {
+    k->reading[i] = 0;
+    k->visits[i] = 0;
+    k->seen[i] = 0;
+    k->filtered[i] = 2048 << 4;
+    k->value[i] = 2048;
+  }
+  k->changes = 0;
+}
+
+// Call once per sample with the two readings of the mux ADC line. Returns
+// true when the mux must be switched to k->position before the next sample,
+// which is also when there is a new reading for knob_scanner_update.
+bool __not_in_flash_func(knob_scanner_sample)(knob_scanner *k, uint16_t a,
+                                              uint16_t b) {
+  if (k->count >= KNOB_SETTLE_SAMPLES) k->sum += a + b;
+  if (++k->count < KNOB_SCAN_SAMPLES) return false;
+
+  uint8_t knob = k->position;
+  k->reading[knob] = k->sum;
+  k->visits[knob]++;
+
+  k->position = (knob + 1) & (KNOB_COUNT - 1);
+  k->count = 0;
+  k->sum = 0;
+  return true;
+}
+
+// Filter the readings taken since the last call and publish the knobs that
+// moved. Call from one place only, outside the ISR.
+void __not_in_flash_func(knob_scanner_update)(knob_scanner *k) {
+  for (int knob = 0; knob < KNOB_COUNT; knob++) {
+    uint8_t visits = k->visits[knob];
+    if (visits == k->seen[knob]) continue;
+    k->seen[knob] = visits;
+
+    int32_t reading = k->reading[knob];  // sum of 16, 12-bit << 4
+    k->filtered[knob] += (reading - k->filtered[knob]) >> KNOB_FILTER_SHIFT;
+    int32_t out = k->filtered[knob] >> 4;
+    int32_t diff = out - k->value[knob];
+    if (diff > KNOB_HYSTERESIS || diff < -KNOB_HYSTERESIS) {
+      k->value[knob] = out;
+      k->changes++;
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef NOTETABLE_H
+#define NOTETABLE_H
+
+#include <stdint.h>
+
+#ifndef __not_in_flash_func
+#define __not_in_flash_func(f) f  // host builds
+#endif
+
+////////////////////////////////////////
+// Note to DAC tables
+//
+// Calibration fills one table per CV channel with the DAC setting of every
+// MIDI note, computed exactly as midiToDac always did. Pitches between
+// notes, for pitch bend, portamento or microtuning, are fixed point in
+// 1/256 semitone (NOTE_FRACTION_BITS) and linearly interpolated between the
+// two neighbouring entries, so a CV sample is one lookup and one
+// multiply-shift-add.
+
+#define NOTE_TABLE_NOTES 128
+#define NOTE_FRACTION_BITS 8
+#define NOTE_PITCH(note) ((int32_t)(note) << NOTE_FRACTION_BITS)
+#define NOTE_PITCH_MAX NOTE_PITCH(NOTE_TABLE_NOTES - 1)
+#define NOTE_DAC_MAX 524287
+
+typedef struct {
+  // one extra entry so the top note interpolates without a bounds check
+  int32_t dac[NOTE_TABLE_NOTES + 1];
+} note_table;
+
+// Fill the table from the fixed-point calibration line: mi is the DAC steps
+// per semitone in 1/16, bi the DAC setting of middle C (note 60)
+void note_table_build(note_table *t, int32_t mi, int32_t bi) {
+  for (int note = 0; note < NOTE_TABLE_NOTES; note++) {
+    int32_t dacValue = ((mi * (note - 60)) >> 4) + bi;
+    if (dacValue > NOTE_DAC_MAX) dacValue = NOTE_DAC_MAX;
+    if (dacValue < 0) dacValue = 0;
+    t->dac[note] = dacValue;
+  }
+  t->dac[NOTE_TABLE_NOTES] = t->dac[NOTE_TABLE_NOTES - 1];
+}
+
+// DAC setting for a pitch in 1/256 semitone, clamped to notes 0..127
+uint32_t __not_in_flash_func(note_table_lookup)(const note_table *t,
+                                                int32_t pitch) {
+  if (pitch < 0) pitch = 0;
+  if (pitch > NOTE_PITCH_MAX) pitch = NOTE_PITCH_MAX;
+  int32_t note = pitch >> NOTE_FRACTION_BITS;
+  int32_t fraction = pitch & ((1 << NOTE_FRACTION_BITS) - 1);
+  int32_t a = t->dac[note];
+  return a + (((t->dac[note + 1] - a) * fraction) >> NOTE_FRACTION_BITS);
+}
+
+////////////////////////////////////////
+// Portamento
+//
+// Glides linearly in pitch, so in volts, from the current pitch to a target
+// over a number of samples. The position is kept with 16 more fraction bits
+// than the table takes, so slow glides still move every sample.
+
+typedef struct {
+  int32_t pitch;  // current pitch, 1/256 semitone << 16
+  int32_t step;   // per-sample increment
+  int32_t target;
+  uint32_t remaining;  // samples left in the glide
+} portamento;
+
+void portamento_init(portamento *p, int32_t pitch) {
+  p->pitch = p->target = pitch << 16;
+  p->step = 0;
+  p->remaining = 0;
+}
+
+// Glide to pitch (1/256 semitone, clamped to notes 0..127) over samples,
+// 0 jumps at once
+void portamento_set(portamento *p, int32_t pitch, uint32_t samples) {
+  if (pitch < 0) pitch = 0;
+  if (pitch > NOTE_PITCH_MAX) pitch = NOTE_PITCH_MAX;
+  p->target = pitch << 16;
+  if (samples == 0) {
+    p->pitch = p->target;
+    p->remaining = 0;
+    return;
+  }
+  p->step = ((int64_t)p->target - p->pitch) / (int64_t)samples;
+  p->remaining = samples;
+}
+
+// Call once per sample, returns the pitch in 1/256 semitone
+int32_t __not_in_flash_func(portamento_tick)(portamento *p) {
+  if (p->remaining) {
+    p->pitch = --p->remaining ? p->pitch + p->step : p->target;
+  }
+  return p->pitch >> 16;
+}
+
+#endif
@@ -0,0 +1,71 @@
+// Host check of the note to DAC tables
+//
+// For random calibration lines, every note of a built table must equal the
+// midiToDac expression that the tables replaced, looked up on a whole note
+// or through midiToDac's clamping. Between notes note_table_lookup must lie
+// between the two neighbours and within one DAC step of the straight line
+// between them. Exits non-zero on the first mismatch.
+//
+//   make notetable
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "notetable.h"
+
+#define LINES 100000
+
+// midiToDac before the tables, from the calibration line
+static int32_t old_midi_to_dac(int32_t mi, int32_t bi, int midiNote) {
+  int32_t dacValue = ((mi * (midiNote - 60)) >> 4) + bi;
+  if (dacValue > 524287) dacValue = 524287;
+  if (dacValue < 0) dacValue = 0;
+  return dacValue;
+}
+
+static int32_t random_in(int32_t lo, int32_t hi) {
+  return lo + (int32_t)(((uint32_t)rand() << 8 ^ (uint32_t)rand()) %
+                        (uint32_t)(hi - lo + 1));
+}
+
+int main(void) {
+  srand(1);
+  note_table t;
+  for (int line = 0; line < LINES; line++) {
+    // steps per semitone in 1/16 on either side of the real ones (about
+    // -58000, the DAC falls as the voltage rises), and middle C anywhere
+    // on the DAC and somewhat past it so that both clamps are hit
+    int32_t mi = random_in(-200000, 200000);
+    int32_t bi = random_in(-100000, NOTE_DAC_MAX + 100000);
+    note_table_build(&t, mi, bi);
+    for (int note = -5; note < NOTE_TABLE_NOTES + 5; note++) {
+      int clamped = note < 0 ? 0 : note;
+      if (clamped >= NOTE_TABLE_NOTES) clamped = NOTE_TABLE_NOTES - 1;
+      int32_t want = old_midi_to_dac(mi, bi, clamped);
+      int32_t got = note_table_lookup(&t, NOTE_PITCH(note));
+      if ((note == clamped && t.dac[note] != want) || got != want) {
+        printf("mi %d bi %d note %d: table %d, midiToDac was %d\n", mi, bi,
+               note, got, want);
+        return 1;
+      }
+    }
+    int32_t pitch = random_in(0, NOTE_PITCH_MAX);
+    int note = pitch >> NOTE_FRACTION_BITS;
+    int32_t fraction = pitch & ((1 << NOTE_FRACTION_BITS) - 1);
+    int32_t a = old_midi_to_dac(mi, bi, note);
+    int32_t b = note + 1 < NOTE_TABLE_NOTES ? old_midi_to_dac(mi, bi, note + 1)
+                                            : a;
+    int64_t exact = ((int64_t)a << NOTE_FRACTION_BITS) + (b - a) * fraction;
+    int64_t got = (int64_t)note_table_lookup(&t, pitch) << NOTE_FRACTION_BITS;
+    int32_t lo = a < b ? a : b, hi = a < b ? b : a;
+    if (got < (int64_t)lo << NOTE_FRACTION_BITS ||
+        got > (int64_t)hi << NOTE_FRACTION_BITS ||
+        llabs(got - exact) >= 1 << NOTE_FRACTION_BITS) {
+      printf("mi %d bi %d pitch %d: %d, between %d and %d\n", mi, bi, pitch,
+             note_table_lookup(&t, pitch), a, b);
+      return 1;
+    }
+  }
+  printf("notetable: %d calibration lines match midiToDac\n", LINES);
+  return 0;
+}
@@ -0,0 +1,197 @@
+#ifndef PRESETS_H
+#define PRESETS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "calibration.h"
+
+////////////////////////////////////////
+// Preset store
+//
+// Presets and calibration live in the last flash sectors as an append-only
+// log of one-page records. Saving never rewrites a page: a record goes to
+// the next blank page with a higher sequence number, and the latest valid
+// record of a key wins, so writes move round the whole region and wear it
+// evenly. A record torn by power loss fails its CRC and is skipped.
+//
+// Before the log enters a sector, that sector is erased, and the live
+// records of the sector after it are copied forward, so there is always an
+// erased sector ahead of the log with nothing in it worth keeping.
+//
+// A save only queues the record in RAM. The flash work is done by
+// preset_store_step, one sector erase or one page program per call, so the
+// caller can run it when the audio can stand the stall. Flash access goes
+// through preset_flash, which is the real flash on the device and a plain
+// array on the host.
+
+#define PRESET_SECTOR_SIZE 4096
+#define PRESET_PAGE_SIZE 256
+#define PRESET_PAGES_PER_SECTOR (PRESET_SECTOR_SIZE / PRESET_PAGE_SIZE)
+#define PRESET_SECTORS 4
+#define PRESET_PAGES (PRESET_SECTORS * PRESET_PAGES_PER_SECTOR)
+#define PRESET_KEYS 16  // at most one sector's worth of live records
+#define PRESET_MAGIC 0x5053
+#define PRESET_HEADER_SIZE 12
+#define PRESET_PAYLOAD (PRESET_PAGE_SIZE - PRESET_HEADER_SIZE)
+#define PRESET_NONE 0xFFFF
+
+// Keys 0..PRESET_KEYS-2 are free for presets
+#define PRESET_KEY_CALIBRATION (PRESET_KEYS - 1)  // EEPROM image, ReadEEPROM
+
+typedef struct {
+  uint16_t magic;
+  uint16_t crc;  // CRC-CCITT of key through the end of data[length]
+  uint8_t key;
+  uint8_t length;
+  uint16_t reserved;
+  uint32_t sequence;
+  uint8_t data[PRESET_PAYLOAD];
+} preset_record;
+
+typedef struct {
+  // Region contents, memory mapped (XIP) on the device
+  const uint8_t *base;
+  // Erase one sector / program one page at a byte offset into the region
+  void (*erase)(uint32_t offset);
+  void (*program)(uint32_t offset, const uint8_t *page);
+} preset_flash;
+
+typedef struct {
+  preset_flash flash;
+  uint16_t live[PRESET_KEYS];  // page of each key's latest record
+  uint16_t head;               // next page to write
+  uint32_t sequence;           // of the newest record
+  bool pending;                // record waiting to be written
+  preset_record record;        // staged record, one whole page
+} preset_store;
+
+const preset_record *preset_page(preset_store *s, uint16_t page) {
+  return (const preset_record *)(s->flash.base + page * PRESET_PAGE_SIZE);
+}
+
+uint16_t preset_crc(const preset_record *r) {
+  return CRCencode(&r->key, PRESET_HEADER_SIZE - 4 + r->length);
+}
+
+bool preset_valid(const preset_record *r) {
+  return r->magic == PRESET_MAGIC && r->key < PRESET_KEYS &&
+         r->length <= PRESET_PAYLOAD && r->crc == preset_crc(r);
+}
+
+bool preset_blank(const uint8_t *bytes, uint32_t length) {
+  for (uint32_t i = 0; i < length; i++) {
+    if (bytes[i] != 0xFF) return false;
+  }
+  return true;
+}
+
+// Scan the region and rebuild the index. The log continues after the
+// newest valid record.
+void preset_store_mount(preset_store *s, preset_flash flash) {
+  s->flash = flash;
+  s->sequence = 0;
+  s->head = 0;
+  s->pending = false;
+  for (int k = 0; k < PRESET_KEYS; k++) s->live[k] = PRESET_NONE;
+
+  uint32_t keySequence[PRESET_KEYS] = {0};
+  for (uint16_t page = 0; page < PRESET_PAGES; page++) {
+    const preset_record *r = preset_page(s, page);
+    if (!preset_valid(r)) continue;
+    if (s->live[r->key] == PRESET_NONE || r->sequence > keySequence[r->key]) {
+      s->live[r->key] = page;
+      keySequence[r->key] = r->sequence;
+    }
+    if (r->sequence > s->sequence) {
+      s->sequence = r->sequence;
+      s->head = (page + 1) % PRESET_PAGES;
+    }
+  }
+}
+
+// Latest data saved under key, copied into data. Returns its length, or -1
+// if the key was never saved. A save still pending is not visible yet.
+int preset_store_load(preset_store *s, uint8_t key, uint8_t *data,
+                      int maxLength) {
+  if (key >= PRESET_KEYS || s->live[key] == PRESET_NONE) return -1;
+  const preset_record *r = preset_page(s, s->live[key]);
+  int length = r->length < maxLength ? r->length : maxLength;
+  memcpy(data, r->data, length);
+  return r->length;
+}
+
+// Queue data to be saved under key. Returns false if another save is still
+// pending, or the data does not fit a record.
+bool preset_store_save(preset_store *s, uint8_t key, const uint8_t *data,
+                       int length) {
+  if (s->pending || key >= PRESET_KEYS || length < 0 ||
+      length > PRESET_PAYLOAD) {
+    return false;
+  }
+  memset(&s->record, 0xFF, sizeof(s->record));
+  s->record.magic = PRESET_MAGIC;
+  s->record.key = key;
+  s->record.length = length;
+  memcpy(s->record.data, data, length);
+  s->pending = true;
+  return true;
+}
+
+// Write the staged record at the head
+void preset_store_append(preset_store *s, preset_record *r) {
+  r->sequence = ++s->sequence;
+  r->crc = preset_crc(r);
+  s->flash.program(s->head * PRESET_PAGE_SIZE, (const uint8_t *)r);
+  if (preset_valid(preset_page(s, s->head))) s->live[r->key] = s->head;
+  s->head = (s->head + 1) % PRESET_PAGES;
+}
+
+// First live record in the sector after the head's, or PRESET_NONE
+uint16_t preset_store_next_evacuee(preset_store *s) {
+  uint16_t start = (s->head / PRESET_PAGES_PER_SECTOR + 1) % PRESET_SECTORS *
+                   PRESET_PAGES_PER_SECTOR;
+  for (int k = 0; k < PRESET_KEYS; k++) {
+    uint16_t page = s->live[k];
+    if (page >= start && page < start + PRESET_PAGES_PER_SECTOR) return page;
+  }
+  return PRESET_NONE;
+}
+
+// True while a step has flash work to do
+bool preset_store_busy(preset_store *s) {
+  return s->pending || preset_store_next_evacuee(s) != PRESET_NONE;
+}
+
+// Do one flash operation: skip a used page, erase the sector the log is
+// entering, copy forward one live record from the sector ahead, or write
+// the pending record, in that order. Returns preset_store_busy afterwards.
+bool preset_store_step(preset_store *s) {
+  if (!preset_store_busy(s)) return false;
+
+  const uint8_t *head = s->flash.base + s->head * PRESET_PAGE_SIZE;
+  if (s->head % PRESET_PAGES_PER_SECTOR == 0) {
+    if (!preset_blank(head, PRESET_SECTOR_SIZE)) {
+      s->flash.erase(s->head * PRESET_PAGE_SIZE);
+      return true;
+    }
+  } else if (!preset_blank(head, PRESET_PAGE_SIZE)) {
+    // Left over from a write or erase cut short by power loss
+    s->head = (s->head + 1) % PRESET_PAGES;
+    return true;
+  }
+
+  uint16_t evacuee = preset_store_next_evacuee(s);
+  if (evacuee != PRESET_NONE) {
+    preset_record copy;
+    memcpy(&copy, preset_page(s, evacuee), sizeof(copy));
+    preset_store_append(s, &copy);
+  } else {
+    preset_store_append(s, &s->record);
+    s->pending = false;
+  }
+  return preset_store_busy(s);
+}
+
+#endif
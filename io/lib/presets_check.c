@@ -0,0 +1,137 @@
+// Host check of the preset store
+//
+// Saves random data under random keys into a simulated flash region and
+// cuts the power at random flash operations, part way through an erase or
+// a page program. After every cut the store is mounted again from what is
+// left, and every key must load as its last completed save, except the key
+// whose save was cut, which may load as either that save or the one
+// before. The flash model also fails the check if a page is programmed
+// without being erased first. At the end the sector erase counts must be
+// even, as the log moves round the whole region. Exits non-zero on the
+// first failure.
+//
+//   make presets
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "presets.h"
+
+#define SAVES 20000
+#define CUT_ODDS 100  // one flash operation in CUT_ODDS loses power
+
+static uint8_t region[PRESET_SECTORS * PRESET_SECTOR_SIZE];
+static uint32_t erases[PRESET_SECTORS];
+static jmp_buf powerCut;
+static int cuts, eraseCuts, failures;
+
+// The bytes saved under each key, length -1 for never
+typedef struct {
+  int length;
+  uint8_t data[PRESET_PAYLOAD];
+} saved;
+
+static bool cut_now(void) { return rand() % CUT_ODDS == 0; }
+
+// A cut erase leaves part of the sector erased
+static void sim_erase(uint32_t offset) {
+  uint32_t length = PRESET_SECTOR_SIZE;
+  bool cut = cut_now();
+  if (cut) length = rand() % PRESET_SECTOR_SIZE;
+  memset(region + offset, 0xFF, length);
+  erases[offset / PRESET_SECTOR_SIZE]++;
+  if (cut) {
+    eraseCuts++;
+    longjmp(powerCut, 1);
+  }
+}
+
+// Programming only clears bits, a cut program clears some of them
+static void sim_program(uint32_t offset, const uint8_t *page) {
+  if (!preset_blank(region + offset, PRESET_PAGE_SIZE)) {
+    printf("page %u programmed without an erase\n",
+           offset / PRESET_PAGE_SIZE);
+    failures++;
+  }
+  uint32_t length = PRESET_PAGE_SIZE;
+  bool cut = cut_now();
+  if (cut) length = rand() % PRESET_PAGE_SIZE;
+  for (uint32_t i = 0; i < length; i++) region[offset + i] &= page[i];
+  if (cut) longjmp(powerCut, 1);
+}
+
+static bool matches(preset_store *s, int key, const saved *want) {
+  uint8_t data[PRESET_PAYLOAD];
+  int length = preset_store_load(s, key, data, PRESET_PAYLOAD);
+  return length == want->length &&
+         (length < 0 || !memcmp(data, want->data, length));
+}
+
+int main(void) {
+  srand(1);
+  memset(region, 0xFF, sizeof(region));
+  preset_flash flash = {region, sim_erase, sim_program};
+  static preset_store store;
+  static saved last[PRESET_KEYS];
+  for (int k = 0; k < PRESET_KEYS; k++) last[k].length = -1;
+  preset_store_mount(&store, flash);
+
+  int save;
+  for (save = 0; save < SAVES && !failures; save++) {
+    static int key;
+    static saved next;
+    key = rand() % PRESET_KEYS;
+    next.length = rand() % (PRESET_PAYLOAD + 1);
+    for (int i = 0; i < next.length; i++) next.data[i] = rand();
+    if (!preset_store_save(&store, key, next.data, next.length)) {
+      printf("save %d refused\n", save);
+      return 1;
+    }
+    if (setjmp(powerCut) == 0) {
+      while (preset_store_step(&store)) continue;
+      last[key] = next;
+      continue;
+    }
+
+    // Power cut: mount what is left, the cut save may or may not be there
+    cuts++;
+    preset_store_mount(&store, flash);
+    if (matches(&store, key, &next)) last[key] = next;
+    for (int k = 0; k < PRESET_KEYS; k++) {
+      if (!matches(&store, k, &last[k])) {
+        printf("save %d, cut %d: key %d lost\n", save, cuts, k);
+        failures++;
+      }
+    }
+    // Finish the copying forward the cut left, the next save's check
+    // covers it
+    if (setjmp(powerCut) == 0) {
+      while (preset_store_step(&store)) continue;
+    } else {
+      cuts++;
+      preset_store_mount(&store, flash);
+    }
+  }
+
+  // A final mount must see every last save
+  preset_store_mount(&store, flash);
+  for (int k = 0; k < PRESET_KEYS; k++) {
+    if (!matches(&store, k, &last[k])) {
+      printf("final mount: key %d lost\n", k);
+      failures++;
+    }
+  }
+  uint32_t least = erases[0], most = erases[0];
+  for (int i = 1; i < PRESET_SECTORS; i++) {
+    if (erases[i] < least) least = erases[i];
+    if (erases[i] > most) most = erases[i];
+  }
+  printf("presets: %d saves, %d power cuts (%d in erases), %u..%u erases "
+         "per sector\n", save, cuts, eraseCuts, least, most);
+  // A cut erase is done again, so it can cost its sector one extra
+  if (most - least > 1 + (uint32_t)eraseCuts) {
+    printf("erases not spread evenly\n");
+    failures++;
+  }
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,157 @@
+#ifndef PULSEIN_H
+#define PULSEIN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef __not_in_flash_func
+#define __not_in_flash_func(f) f  // host builds
+#endif
+
+#include "clock.h"
+
+////////////////////////////////////////
+// Pulse input capture
+//
+// The pulse inputs raise a GPIO interrupt on each incoming pulse, and the
+// handler only stores the microsecond timer in a ring. Nothing runs per
+// sample: the main loop drains the rings, feeds the timestamps to a tempo
+// estimator and steers the internal clock from it.
+//
+// The handler runs on the core that enabled the interrupt, which is also
+// the core draining the ring, so the indices need no more than volatile.
+
+#define PULSE_RING_SIZE 16  // power of two
+
+typedef struct {
+  uint32_t time[PULSE_RING_SIZE];  // time_us_32 of each pulse
+  volatile uint8_t head;           // written by the interrupt
+  volatile uint8_t tail;           // written by the reader
+  volatile uint32_t dropped;       // pulses lost to a full ring
+} pulse_ring;
+
+void pulse_ring_init(pulse_ring *r) {
+  r->head = 0;
+  r->tail = 0;
+  r->dropped = 0;
+}
+
+// Interrupt side
+void __not_in_flash_func(pulse_ring_push)(pulse_ring *r, uint32_t time) {
+  uint8_t head = r->head;
+  if ((uint8_t)(head - r->tail) == PULSE_RING_SIZE) {
+    r->dropped++;
+    return;
+  }
+  r->time[head & (PULSE_RING_SIZE - 1)] = time;
+  r->head = head + 1;
+}
+
+// Reader side, returns false when empty
+bool pulse_ring_pop(pulse_ring *r, uint32_t *time) {
+  uint8_t tail = r->tail;
+  if (tail == r->head) return false;
+  *time = r->time[tail & (PULSE_RING_SIZE - 1)];
+  r->tail = tail + 1;
+  return true;
+}
+
+////////////////////////////////////////
+// Tempo estimator
+//
+// Locks once two consecutive intervals agree within a quarter, then
+// follows the period with a one-pole low pass, so jitter on single pulses
+// is averaged out. An interval far from the estimate is treated as a
+// glitch or a missed pulse and ignored, unless the next interval agrees
+// with it, in which case the tempo has changed and the estimate jumps to
+// it. Pulses closer than TEMPO_MIN_INTERVAL_US are contact bounce; a gap
+// longer than TEMPO_TIMEOUT_US means the source stopped, and the estimator
+// starts over.
+
+#define TEMPO_MIN_INTERVAL_US 2000      // 500Hz, fastest accepted clock
+#define TEMPO_TIMEOUT_US 4000000        // 0.25Hz, slowest accepted clock
+#define TEMPO_TOLERANCE_SHIFT 2         // intervals agree within 1/4
+#define TEMPO_SMOOTHING_SHIFT 2         // period += (interval - period) >> 2
+#define TEMPO_INCR_US 89478485333ull    // clock increment for a 1us period
+
+typedef struct {
+  uint32_t last;       // time of the last accepted pulse, us
+  uint32_t period;     // estimated period, us << 8, valid when locked
+  uint32_t candidate;  // last interval that disagreed with the estimate, us
+  bool started;        // a first pulse has been seen
+  bool locked;
+} tempo_estimator;
+
+void tempo_estimator_init(tempo_estimator *e) {
+  e->last = 0;
+  e->period = 0;
+  e->candidate = 0;
+  e->started = false;
+  e->locked = false;
+}
+
+bool tempo_agrees(uint32_t a, uint32_t b) {
+  uint32_t diff = a > b ? a - b : b - a;
+  return diff <= (b >> TEMPO_TOLERANCE_SHIFT);
+}
+
+// Feed one pulse timestamp. Returns true when the pulse was on the beat of
+// a locked tempo, so it can be used to correct the phase.
+bool tempo_estimator_pulse(tempo_estimator *e, uint32_t time) {
+  if (!e->started) {
+    e->started = true;
+    e->last = time;
+    return false;
+  }
+  uint32_t interval = time - e->last;
+  if (interval < TEMPO_MIN_INTERVAL_US) return false;
+  e->last = time;
+
+  if (interval > TEMPO_TIMEOUT_US) {
+    e->locked = false;
+    e->candidate = 0;
+    return false;
+  }
+
+  if (e->locked && tempo_agrees(interval, e->period >> 8)) {
+    e->period += ((int32_t)(interval << 8) - (int32_t)e->period) >>
+                 TEMPO_SMOOTHING_SHIFT;
+    e->candidate = 0;
+    return true;
+  }
+
+  // Outlier, or not locked yet: lock on two agreeing intervals
+  if (e->candidate && tempo_agrees(interval, e->candidate)) {
+    e->period = ((interval + e->candidate) << 8) >> 1;
+    e->locked = true;
+    e->candidate = 0;
+    return true;
+  }
+  e->candidate = interval;
+  return false;
+}
+
+// Clock increment that makes one clock cycle per pulse period
+uint32_t tempo_estimator_increment(tempo_estimator *e) {
+  if (!e->locked) return 0;
+  return (TEMPO_INCR_US << 8) / e->period;
+}
+
+// Steer a clock ticking at 48kHz to follow the pulses: its frequency is set
+// to the estimated tempo, trimmed so that half of the phase error seen at
+// the last pulse is taken out over the next period. Only the increment is
+// written, so this is safe while another core ticks the clock. now is
+// time_us_32 at the call.
+void tempo_estimator_sync_clock(tempo_estimator *e, clock *c, uint32_t now) {
+  uint32_t base = tempo_estimator_increment(e);
+  if (base == 0) return;
+  // Wind the count back to where it was when the pulse arrived
+  uint32_t elapsed = (uint64_t)(now - e->last) * 48 / 1000;
+  uint32_t count = c->count - elapsed * c->increment;
+  // A pulse should land on the clock's rising edge, at 2^31. The error is
+  // at most half a cycle, so the trim is at most a quarter of base.
+  int32_t error = count - 0x80000000;
+  clock_set_freq_incr(c, base - (((int64_t)error * base) >> 33));
+}
+
+#endif
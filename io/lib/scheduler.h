@@ -0,0 +1,66 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef __not_in_flash_func
+#define __not_in_flash_func(f) f  // host builds
+#endif
+
+////////////////////////////////////////
+// Cooperative job scheduler for the audio core
+//
+// The per-sample ISR only does what must happen every sample and posts
+// anything else as a job. The audio core's main loop runs posted jobs
+// between interrupts, lowest id first, each to completion, and sleeps
+// until the next interrupt when there is nothing left to do. A job is
+// posted at most once: posting it again before it has run is counted as
+// an overrun, which means the job is slower than its posting rate.
+//
+// pending is only ever set from the ISR and taken from the main loop with
+// the ISR masked, so a single word is enough.
+
+#define SCHEDULER_JOBS 8
+
+typedef void (*scheduler_job)(void);
+
+typedef struct {
+  scheduler_job jobs[SCHEDULER_JOBS];
+  volatile uint32_t pending;   // bit per posted job
+  volatile uint32_t overruns;  // posts of a job that was still pending
+  uint32_t runs;               // jobs run, for telemetry
+} scheduler;
+
+void scheduler_init(scheduler *s) {
+  for (int i = 0; i < SCHEDULER_JOBS; i++) s->jobs[i] = 0;
+  s->pending = 0;
+  s->overruns = 0;
+  s->runs = 0;
+}
+
+void scheduler_add(scheduler *s, uint8_t id, scheduler_job job) {
+  s->jobs[id] = job;
+}
+
+// ISR side
+void __not_in_flash_func(scheduler_post)(scheduler *s, uint8_t id) {
+  uint32_t bit = 1u << id;
+  if (s->pending & bit) s->overruns++;
+  s->pending |= bit;
+}
+
+// Main loop side: run the jobs in taken, a mask from scheduler_take.
+// Returns false if there were none.
+bool __not_in_flash_func(scheduler_run)(scheduler *s, uint32_t taken) {
+  if (!taken) return false;
+  for (int id = 0; taken; id++, taken >>= 1) {
+    if ((taken & 1) && s->jobs[id]) {
+      s->jobs[id]();
+      s->runs++;
+    }
+  }
+  return true;
+}
+
+#endif
@@ -1,5 +1,7 @@
 #include <errno.h>
 #include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -8,178 +10,357 @@
 #include <time.h>
 #include <unistd.h>
 
-#include "adsr.h"
-#include "verb.h"
+#include "batch.h"
+#include "blockstats.h"
+#include "convverb.h"
+#include "events.h"
+#include "midi.h"
+#include "pcm.h"
+#include "synth.h"
+#include "telemetry.h"
+#include "wav.h"
 
 const int block_size = 8192;
 
-// create a saw wave struct
-typedef struct LFSaw {
-  float phase;
-  float sample_rate;
-  float amplitude;
-  float phase_increment;
-} LFSaw;
-
-void LFSaw_init(LFSaw *saw, float freq, float sample_rate, float amplitude) {
-  // choose random phase
-  saw->phase = (float)rand() / RAND_MAX;
-  saw->sample_rate = sample_rate;
-  saw->amplitude = amplitude;
-  saw->phase_increment = freq / sample_rate;
-}
+// samples rendered per reverb block
+#define RENDER_BLOCK 256
 
-void LFSaw_set_freq(LFSaw *saw, float freq) {
-  saw->phase_increment = freq / saw->sample_rate;
-}
+// voice pool and mix level used for MIDI files
+#define MIDI_VOICES 16
+#define MIDI_GAIN 0.25f
+// seconds rendered after the last MIDI event, for releases and reverb tails
+#define MIDI_TAIL 4
 
-float LFSaw_next_sample(LFSaw *saw) {
-  float next = saw->phase * saw->amplitude;
-  saw->phase += saw->phase_increment;
-  if (saw->phase >= 1) {
-    saw->phase -= 2;
+// Load an impulse response and build a convolution reverb from it
+struct sConvVerb *load_convolution(const char *path, int partition) {
+  // range check before ConvVerb_create narrows it to uint16_t
+  if (partition < CONVVERB_MIN_BLOCK || partition > CONVVERB_MAX_BLOCK) {
+    fprintf(stderr, "partition size must be a power of two in %d..%d\n",
+            CONVVERB_MIN_BLOCK, CONVVERB_MAX_BLOCK);
+    return NULL;
+  }
+  uint16_t channels;
+  uint32_t sample_rate, frames;
+  float *ir = Wav_read(path, &channels, &sample_rate, &frames);
+  if (!ir) {
+    fprintf(stderr, "could not read impulse response %s\n", path);
+    return NULL;
   }
-  return next;
+  if (sample_rate != 48000) {
+    fprintf(stderr, "warning: %s is %u Hz, rendering at 48000 Hz\n", path,
+            sample_rate);
+  }
+  struct sConvVerb *conv = ConvVerb_create(ir, channels, frames, partition);
+  free(ir);
+  if (!conv) {
+    fprintf(stderr, "partition size must be a power of two in %d..%d\n",
+            CONVVERB_MIN_BLOCK, CONVVERB_MAX_BLOCK);
+    return NULL;
+  }
+  fprintf(stderr, "impulse response: %s, %u ch, %.2f s\n", path, channels,
+          (double)(frames / 48000.0f));
+  return conv;
 }
 
-typedef struct LFSaws {
-  LFSaw saws[7];
-} LFSaws;
-
-float detuneCurve(float x) {
-  return (10028.7312891634 * pow(x, 11)) - (50818.8652045924 * pow(x, 10)) +
-         (111363.4808729368 * pow(x, 9)) - (138150.6761080548 * pow(x, 8)) +
-         (106649.6679158292 * pow(x, 7)) - (53046.9642751875 * pow(x, 6)) +
-         (17019.9518580080 * pow(x, 5)) - (3425.0836591318 * pow(x, 4)) +
-         (404.2703938388 * pow(x, 3)) - (24.1878824391 * pow(x, 2)) +
-         (0.6717417634 * x) + 0.0030115596;
+uint32_t elapsed_ns(struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) * 1000000000 +
+         (now.tv_nsec - start->tv_nsec);
 }
 
-float detuneAmounts[7] = {-0.11002313, -0.06288439, -0.01952356, 0,
-                          0.01991221,  0.06216538,  0.10745242};
-
-float amplitudeAmounts[7] = {0.5, 0.3, 0.4, 0.8, 0.8, 0.4, 0.3};
-void LFSaws_init(LFSaws *saws, float freq, float sample_rate) {
-  float detuneFactor = freq * detuneCurve(0.6);
-  // print to stderr
-  fprintf(stderr, "detuneFactor: %f\n", detuneFactor);
-  for (int i = 0; i < 7; i++) {
-    LFSaw_init(&saws->saws[i], freq + detuneFactor * detuneAmounts[i],
-               sample_rate, amplitudeAmounts[i] / 4.0);
-  }
+double elapsed_seconds(struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) * 1e-9;
 }
 
-float LFSaws_next_sample(LFSaws *saws) {
-  float next = 0;
-  for (int i = 0; i < 7; i++) {
-    next += LFSaw_next_sample(&saws->saws[i]);
+// Queue one MIDI event, false if the synth's event queue is full
+bool post_midi_event(Synth *synth, uint64_t time, const MidiEvent *e) {
+  uint8_t type = e->status & 0xF0, channel = e->status & 0x0F;
+  if (type == MIDI_NOTE_ON && e->data2 > 0) {
+    return Synth_note_on(synth, time, channel, e->data1, e->data2 / 127.0f);
+  } else if (type == MIDI_NOTE_OFF || type == MIDI_NOTE_ON) {
+    return Synth_note_off(synth, time, channel, e->data1);
   }
-  return next;
+  return true;
 }
 
-typedef struct WhiteNoise {
-  float amplitude;
-} WhiteNoise;
+// Render a Standard MIDI File through the voice pool and reverb into the
+// file open in out. Every block only queues the MIDI events that fall inside
+// it, so the file is streamed rather than loaded.
+int render_midi(const char *midi_path, struct sWavWriter *out,
+                struct sConvVerb *conv) {
+  struct sMidiFile *midi = MidiFile_open(midi_path);
+  if (!midi) {
+    fprintf(stderr, "could not read MIDI file %s\n", midi_path);
+    return 1;
+  }
+  Synth *synth = Synth_create(MIDI_VOICES, 48000);
+  synth->conv = conv;
+  synth->gain = MIDI_GAIN;
+  Synth_set_giant_reverb(synth);
 
-void WhiteNoise_init(WhiteNoise *noise, float amplitude) {
-  noise->amplitude = amplitude;
-}
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
 
-float WhiteNoise_next_sample(WhiteNoise *noise) {
-  return ((float)rand() / RAND_MAX - 0.5) * noise->amplitude;
-}
+  MidiEvent e;
+  bool more = MidiFile_next(midi, &e);
+  uint64_t end = 0;  // last sample to render once the file is exhausted
+  float wetL[RENDER_BLOCK], wetR[RENDER_BLOCK];
+  bool ok = true;
+  uint32_t dropped = 0;  // events that did not fit the queue even after a flush
+  while (more || synth->time < end) {
+    uint64_t block_end = synth->time + RENDER_BLOCK;
+    while (more) {
+      uint64_t time = (uint64_t)(e.seconds * 48000 + 0.5);
+      if (time >= block_end) break;
+      bool posted = post_midi_event(synth, time, &e);
+      if (!posted && time > synth->time) {
+        // queue full: render up to this event to drain it, then retry
+        uint16_t n = time - synth->time;
+        Synth_render(synth, wetL, wetR, n);
+        ok = WavWriter_write(out, wetL, wetR, n) && ok;
+        posted = post_midi_event(synth, time, &e);
+      }
+      if (!posted) dropped++;
+      end = time + MIDI_TAIL * 48000;
+      more = MidiFile_next(midi, &e);
+    }
+    // short if events were flushed early
+    uint16_t n = block_end - synth->time;
+    Synth_render(synth, wetL, wetR, n);
+    ok = WavWriter_write(out, wetL, wetR, n) && ok;
+  }
 
-typedef struct OnePole {
-  float prev_out;
-} OnePole;
+  double seconds = elapsed_seconds(&start);
+  double rendered = synth->time / 48000.0;
+  fprintf(stderr, "rendered %.1f s in %.2f s, %.1fx realtime (%s reverb)\n",
+          rendered, seconds, rendered / seconds,
+          conv ? "convolution" : REVERB_NAME);
+  if (dropped) {
+    fprintf(stderr, "%u MIDI events dropped, too many at the same time\n",
+            dropped);
+    ok = false;
+  }
 
-// out(i) = ((1 - abs(coef)) * in(i)) + (coef * out(i-1)).
-float OnePole_next(OnePole *self, float in, float coef) {
-  float out = ((1 - fabs(coef)) * in) + (coef * self->prev_out);
-  self->prev_out = out;
-  return out;
+  Synth_delete(synth);
+  MidiFile_close(midi);
+  return ok ? 0 : 1;
 }
 
-typedef struct Voice {
-  LFSaws saws;
-  OnePole one_pole;
-  ADSR adsr;
-  WhiteNoise noise;
-  float amp;
-} Voice;
-
-void Voice_init(Voice *voice, float freq, float amp, float sample_rate) {
-  voice->amp = amp;
-  // WhiteNoise_init(&voice->noise, 0.05);
-  LFSaws_init(&voice->saws, freq, sample_rate);
-  OnePole one_pole;
-  ADSR_init(&voice->adsr, 4, 1, 0.707, 0.5, 2.0, 48000);
-}
+// Logging thread for -v: drains the telemetry the render loop pushes every
+// block and prints one line per second of audio, so formatting and stderr
+// writes stay off the render path
+typedef struct TelemetryLog {
+  Telemetry telemetry;
+  atomic_bool done;
+  pthread_t thread;
+} TelemetryLog;
 
-float Voice_next_sample(Voice *voice) {
-  float sample = 0;
-  sample += LFSaws_next_sample(&voice->saws);
-  sample += WhiteNoise_next_sample(&voice->noise);
-  // generate random number between 0.97 and 0.99
-  float random = (float)rand() / RAND_MAX * 0.18 + 0.8;
-  sample = OnePole_next(&voice->one_pole, sample, random);
-  sample = sample * ADSR_process(&voice->adsr);
-  sample = sample * voice->amp;
-  return sample;
+void *telemetry_log_main(void *arg) {
+  TelemetryLog *log = arg;
+  TelemetryRecord r, second = {.min = INFINITY, .max = -INFINITY};
+  for (;;) {
+    bool done = atomic_load(&log->done);
+    bool any = false;
+    while (Telemetry_pop(&log->telemetry, &r)) {
+      any = true;
+      second.frames += r.frames;
+      if (r.ticks > second.ticks) second.ticks = r.ticks;
+      if (r.voices > second.voices) second.voices = r.voices;
+      if (r.min < second.min) second.min = r.min;
+      if (r.max > second.max) second.max = r.max;
+      if (second.frames >= 48000) {
+        fprintf(stderr,
+                "block %5u: voices %u, slowest block %.1f us, "
+                "level %.3f..%.3f, dropped %u\n",
+                r.block, second.voices, second.ticks / 1e3, (double)second.min,
+                (double)second.max, Telemetry_dropped(&log->telemetry));
+        second = (TelemetryRecord){.min = INFINITY, .max = -INFINITY};
+      }
+    }
+    if (done) break;
+    if (!any) usleep(1000);
+  }
+  return NULL;
 }
 
-void Voice_gate(Voice *voice, bool gate) { ADSR_gate(&voice->adsr, gate); }
-
-void Voice_set_release(Voice *voice, float release) {
-  ADSR_set_release(&voice->adsr, release);
+void usage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [-i impulse.wav] [-p partition]"
+          " [-m song.mid] [-b jobs.txt [-j threads]]\n"
+          "          [-o out.wav [-f 16|24|32] [-d]] [-v]\n"
+          "  -i  use convolution reverb with this impulse response\n"
+          "  -p  convolution partition size, %d..%d (default %d)\n"
+          "  -m  render a Standard MIDI File instead of the drone, needs -o\n"
+          "  -b  render every job of a job list, see batch.h\n"
+          "  -j  batch worker threads (default one per core)\n"
+          "  -o  write a WAV file instead of raw int16 to stdout\n"
+          "  -f  WAV sample format: 16 or 24-bit PCM, or 32-bit float\n"
+          "  -d  TPDF dither the PCM formats\n"
+          "  -v  log voices, block times and levels every second of audio\n",
+          name, CONVVERB_MIN_BLOCK, CONVVERB_MAX_BLOCK, RENDER_BLOCK);
 }
 
 int main(int argc, char *argv[]) {
+  const char *ir_path = NULL;
+  const char *midi_path = NULL;
+  const char *out_path = NULL;
+  const char *jobs_path = NULL;
+  int threads = 0;
+  int partition = RENDER_BLOCK;
+  int format = WAV_PCM16;
+  bool dither = false;
+  bool verbose = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "i:p:m:o:b:j:f:dvh")) != -1) {
+    switch (opt) {
+      case 'v':
+        verbose = true;
+        break;
+      case 'f':
+        format = atoi(optarg);
+        break;
+      case 'd':
+        dither = true;
+        break;
+      case 'b':
+        jobs_path = optarg;
+        break;
+      case 'j':
+        threads = atoi(optarg);
+        break;
+      case 'i':
+        ir_path = optarg;
+        break;
+      case 'm':
+        midi_path = optarg;
+        break;
+      case 'o':
+        out_path = optarg;
+        break;
+      case 'p':
+        partition = atoi(optarg);
+        break;
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+  if (midi_path && !out_path) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (format != WAV_PCM16 && format != WAV_PCM24 && format != WAV_FLOAT32) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (jobs_path) {
+    return Batch_render(jobs_path, threads, format, dither);
+  }
+
   // Initialize random number generator
   srand(time(NULL));
 
-  // reverb
-  struct sDattorroVerb *verb = DattorroVerb_create();
-  // giant reverb
-  DattorroVerb_setPreDelay(verb, 0.2);
-  DattorroVerb_setPreFilter(verb, 0.9);
-  DattorroVerb_setInputDiffusion1(verb, 0.85);
-  DattorroVerb_setInputDiffusion2(verb, 0.75);
-  DattorroVerb_setDecayDiffusion(verb, 0.5);
-  DattorroVerb_setDecay(verb, 0.9);
-  DattorroVerb_setDamping(verb, 0.4);
+  // convolution reverb replaces the algorithmic one when given an IR
+  struct sConvVerb *conv = NULL;
+  if (ir_path) {
+    conv = load_convolution(ir_path, partition);
+    if (!conv) return 1;
+  }
+
+  struct sWavWriter *out = NULL;
+  if (out_path) {
+    out = WavWriter_create(2, 48000, format, dither);
+    if (!out || !WavWriter_open(out, out_path)) {
+      fprintf(stderr, "could not write %s\n", out_path);
+      return 1;
+    }
+  }
+
+  if (midi_path) {
+    int status = render_midi(midi_path, out, conv);
+    if (!WavWriter_close(out)) status = 1;
+    WavWriter_delete(out);
+    if (conv) ConvVerb_delete(conv);
+    return status;
+  }
 
 #define NUM_VOICES 3
-  Voice voice[NUM_VOICES];
+  Synth *synth = Synth_create(NUM_VOICES, 48000);
+  synth->conv = conv;
+
+  // reverb
+  Synth_set_giant_reverb(synth);
+
   // overtone series
   float freqs[7] = {440, 550, 110, 55, 1760, 3520, 7040};
   float amps[7] = {0.75, 0.5, 0.25, 0.25, 0.125, 0.0625, 0.03125};
   for (int i = 0; i < NUM_VOICES; i++) {
-    Voice_init(&voice[i], freqs[i] / 2, amps[i], 48000);
-    Voice_gate(&voice[i], true);
-    Voice_set_release(&voice[i], 0.1);
+    Voice_set_release(&synth->voices[i], 0.1);
+    Event on = {.time = 0,
+                .type = event_note_on,
+                .voice = i,
+                .value = freqs[i] / 2,
+                .amp = amps[i]};
+    Event off = {.time = 48000 * 5, .type = event_note_off, .voice = i};
+    Synth_post(synth, &on);
+    Synth_post(synth, &off);
+  }
+
+  // block render times in ns, against the time a block lasts
+  BlockStats stats;
+  BlockStats_init(&stats, RENDER_BLOCK * 1000000000ull / 48000);
+
+  static TelemetryLog log;
+  if (verbose) {
+    Telemetry_init(&log.telemetry);
+    atomic_init(&log.done, false);
+    if (pthread_create(&log.thread, NULL, telemetry_log_main, &log)) {
+      verbose = false;
+    }
   }
+  uint32_t block = 0;
 
   struct timespec start, end;
   clock_gettime(CLOCK_MONOTONIC, &start);
 
   float total_samples = 48000 * 10;
   int16_t buffer[480000 * 2];
-  for (int i = 1; i < total_samples; i++) {
-    float sample = 0;
-    for (int j = 0; j < NUM_VOICES; j++)
-      sample += Voice_next_sample(&voice[j]) / NUM_VOICES;
-    if (i == 48000 * 5) {
-      for (int j = 0; j < NUM_VOICES; j++) Voice_gate(&voice[j], false);
+  float wetL[RENDER_BLOCK], wetR[RENDER_BLOCK];
+  for (int i = 1; i < total_samples; i += RENDER_BLOCK) {
+    int n = RENDER_BLOCK;
+    if (i + n > total_samples) n = total_samples - i;
+    struct timespec block_start;
+    clock_gettime(CLOCK_MONOTONIC, &block_start);
+    Synth_render(synth, wetL, wetR, n);
+    uint32_t ticks = elapsed_ns(&block_start);
+    BlockStats_record(&stats, ticks);
+    if (verbose) {
+      TelemetryRecord r = {.block = block,
+                           .frames = n,
+                           .ticks = ticks,
+                           .voices = Synth_sounding(synth),
+                           .min = INFINITY,
+                           .max = -INFINITY};
+      Telemetry_levels(&r, wetL, n);
+      Telemetry_levels(&r, wetR, n);
+      Telemetry_push(&log.telemetry, &r);
+    }
+    block++;
+    if (out) {
+      WavWriter_write(out, wetL, wetR, n);
+    } else {
+      // convert sample to int16_t
+      Pcm_from_float16(buffer + i * 2, wetL, wetR, n, NULL);
     }
-    DattorroVerb_process(verb, sample);
-    float sampleL = DattorroVerb_getLeft(verb);
-    float sampleR = DattorroVerb_getRight(verb);
-    // convert sample to int16_t
-    buffer[i * 2] = (int16_t)(sampleL * 32767);
-    buffer[i * 2 + 1] = (int16_t)(sampleR * 32767);
   }
   clock_gettime(CLOCK_MONOTONIC, &end);
+  if (verbose) {
+    atomic_store(&log.done, true);
+    pthread_join(log.thread, NULL);
+  }
   long seconds = end.tv_sec - start.tv_sec;
   long nanoseconds = end.tv_nsec - start.tv_nsec;
   long microseconds = seconds * 1000000 + nanoseconds / 1000;
@@ -195,10 +376,27 @@ int main(int argc, char *argv[]) {
       audio_block_samples / sample_rate * 1000000;  // in microseconds
   float percent =
       microseconds_per_sample2 * audio_block_samples / audio_block_time * 100;
-  fprintf(stderr, "Percent audioblock: %2.1f %%\n", (float)percent);
+  fprintf(stderr, "Percent audioblock: %2.1f %% (%s reverb)\n", (double)percent,
+          conv ? "convolution" : REVERB_NAME);
+  BlockStatsSnapshot snapshot;
+  BlockStats_snapshot(&stats, &snapshot, false);
+  fprintf(stderr,
+          "block us: mean %.1f, p99 < %.1f, max %.1f, %u/%u over %.1f\n",
+          BlockStats_mean(&snapshot) / 1e3,
+          BlockStats_percentile(&snapshot, 0.99f) / 1e3, snapshot.max / 1e3,
+          snapshot.misses, snapshot.blocks, snapshot.deadline / 1e3);
 
-  for (int i = 0; i < total_samples * 2; i++) {
-    fwrite(&buffer[i], sizeof(int16_t), 1, stdout);
+  int status = 0;
+  if (out) {
+    if (!WavWriter_close(out)) {
+      fprintf(stderr, "could not write %s\n", out_path);
+      status = 1;
+    }
+    WavWriter_delete(out);
+  } else {
+    fwrite(buffer, sizeof(int16_t), total_samples * 2, stdout);
   }
-  return 0;
+  Synth_delete(synth);
+  if (conv) ConvVerb_delete(conv);
+  return status;
 }
@@ -0,0 +1,217 @@
+/*
+Standard MIDI File reader
+
+The file is memory mapped and parsed in place: each track keeps a cursor into
+the mapping, and MidiFile_next merges the tracks by always decoding the event
+with the earliest tick, so nothing is copied or buffered. Tempo changes from
+any track update the tick to seconds conversion as they are reached, which
+is what format 1 files with a conductor track need. Format 2 files are merged
+the same way. Malformed or truncated tracks simply end early.
+*/
+
+#include "midi.h"
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MIDI_DEFAULT_TEMPO 500000  // microseconds per quarter note, 120 bpm
+
+typedef struct MidiTrack {
+  const uint8_t* p;  // next unread byte
+  const uint8_t* end;
+  uint64_t tick;   // absolute tick of the event at p
+  uint8_t status;  // running status
+  bool done;
+} MidiTrack;
+
+typedef struct sMidiFile {
+  const uint8_t* data;  // mapped file
+  size_t size;
+  uint16_t division;
+  uint16_t numTracks;
+  MidiTrack* tracks;
+
+  // Tempo map
+  uint32_t tempo;       // microseconds per quarter note
+  uint64_t tempoTick;   // tick of the last tempo change
+  double tempoSeconds;  // time of the last tempo change
+} MidiFile;
+
+static uint32_t be16(const uint8_t* p) { return (p[0] << 8) | p[1]; }
+
+static uint32_t be32(const uint8_t* p) {
+  return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+/* Variable length quantity, ends the track if it runs past the end */
+static uint32_t readVarLen(MidiTrack* t) {
+  uint32_t value = 0;
+  for (int i = 0; i < 4; i++) {
+    if (t->p >= t->end) break;
+    uint8_t byte = *t->p++;
+    value = (value << 7) | (byte & 0x7F);
+    if (!(byte & 0x80)) return value;
+  }
+  t->done = true;
+  return 0;
+}
+
+/* Advance past the delta time to the next event */
+static void readDelta(MidiTrack* t) {
+  if (t->p >= t->end) {
+    t->done = true;
+    return;
+  }
+  t->tick += readVarLen(t);
+}
+
+static double tickSeconds(MidiFile* m, uint64_t tick) {
+  if (m->division & 0x8000) {
+    // SMPTE: frames per second and ticks per frame
+    int fps = -(int8_t)(m->division >> 8);
+    double rate = fps == 29 ? 29.97 : fps;
+    return tick / (rate * (m->division & 0xFF));
+  }
+  return m->tempoSeconds +
+         (tick - m->tempoTick) * (m->tempo * 1e-6 / m->division);
+}
+
+MidiFile* MidiFile_open(const char* path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return NULL;
+  struct stat st;
+  if (fstat(fd, &st) || st.st_size < 14) {
+    close(fd);
+    return NULL;
+  }
+  const uint8_t* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) return NULL;
+
+  MidiFile* m = calloc(1, sizeof(MidiFile));
+  uint32_t headerSize = be32(data + 4);
+  if (!m || memcmp(data, "MThd", 4) || headerSize < 6 ||
+      headerSize > (size_t)st.st_size - 8 || be16(data + 12) == 0) {
+    free(m);
+    munmap((void*)data, st.st_size);
+    return NULL;
+  }
+  m->data = data;
+  m->size = st.st_size;
+  m->division = be16(data + 12);
+  m->tracks = calloc(be16(data + 10), sizeof(MidiTrack));
+  m->tempo = MIDI_DEFAULT_TEMPO;
+
+  // find the track chunks, skipping unknown ones
+  const uint8_t* end = data + m->size;
+  const uint8_t* p = data + 8 + headerSize;
+  while (m->tracks && m->numTracks < be16(data + 10) && end - p >= 8) {
+    uint32_t length = be32(p + 4);
+    const uint8_t* body = p + 8;
+    if (length > (size_t)(end - body)) length = end - body;
+    if (!memcmp(p, "MTrk", 4)) {
+      MidiTrack* t = &m->tracks[m->numTracks++];
+      t->p = body;
+      t->end = body + length;
+      readDelta(t);
+    }
+    p = body + length;
+  }
+  return m;
+}
+
+void MidiFile_close(MidiFile* m) {
+  munmap((void*)m->data, m->size);
+  free(m->tracks);
+  free(m);
+}
+
+bool MidiFile_next(MidiFile* m, MidiEvent* e) {
+  for (;;) {
+    // track with the earliest pending event, ties go to the lower track
+    MidiTrack* t = NULL;
+    for (int i = 0; i < m->numTracks; i++) {
+      MidiTrack* c = &m->tracks[i];
+      if (!c->done && (!t || c->tick < t->tick)) t = c;
+    }
+    if (!t) return false;
+
+    if (t->p >= t->end) {
+      t->done = true;
+      continue;
+    }
+    uint64_t tick = t->tick;
+    uint8_t status = t->status;
+    if (*t->p & 0x80) status = *t->p++;
+    if (!(status & 0x80)) {
+      t->done = true;  // data byte without running status
+      continue;
+    }
+
+    if (status == 0xFF) {
+      // meta event
+      t->status = 0;
+      if (t->p >= t->end) {
+        t->done = true;
+        continue;
+      }
+      uint8_t type = *t->p++;
+      uint32_t length = readVarLen(t);
+      if (length > (size_t)(t->end - t->p)) {
+        t->done = true;
+        continue;
+      }
+      if (type == 0x51 && length == 3) {
+        m->tempoSeconds = tickSeconds(m, tick);
+        m->tempoTick = tick;
+        m->tempo = (t->p[0] << 16) | (t->p[1] << 8) | t->p[2];
+      }
+      t->p += length;
+      if (type == 0x2F) {
+        t->done = true;  // end of track
+        continue;
+      }
+      readDelta(t);
+      continue;
+    }
+
+    if (status == 0xF0 || status == 0xF7) {
+      // system exclusive, skipped
+      t->status = 0;
+      uint32_t length = readVarLen(t);
+      if (length > (size_t)(t->end - t->p)) {
+        t->done = true;
+        continue;
+      }
+      t->p += length;
+      readDelta(t);
+      continue;
+    }
+
+    if (status > 0xF0) {
+      t->done = true;  // system common and real time do not belong in files
+      continue;
+    }
+
+    // channel message, program change and channel pressure have one data
+    // byte
+    int bytes = ((status & 0xE0) == 0xC0) ? 1 : 2;
+    if (t->end - t->p < bytes) {
+      t->done = true;
+      continue;
+    }
+    t->status = status;
+    e->seconds = tickSeconds(m, tick);
+    e->status = status;
+    e->data1 = t->p[0] & 0x7F;
+    e->data2 = bytes == 2 ? t->p[1] & 0x7F : 0;
+    t->p += bytes;
+    readDelta(t);
+    return true;
+  }
+}
@@ -0,0 +1,22 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Channel message read from a Standard MIDI File */
+typedef struct MidiEvent {
+  double seconds;  // time from the start of the file, tempo map applied
+  uint8_t status;  // message type | channel
+  uint8_t data1;   // e.g. note number
+  uint8_t data2;   // e.g. velocity, 0 for one byte messages
+} MidiEvent;
+
+#define MIDI_NOTE_OFF 0x80
+#define MIDI_NOTE_ON 0x90
+
+/* Map a format 0 or 1 Standard MIDI File. Returns NULL if the file cannot be
+   read or is not a MIDI file. */
+struct sMidiFile* MidiFile_open(const char* path);
+void MidiFile_close(struct sMidiFile* m);
+
+/* Read the next channel message of any track, in time order. Returns false
+   at the end of the file. */
+bool MidiFile_next(struct sMidiFile* m, MidiEvent* e);
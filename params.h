@@ -0,0 +1,61 @@
+#ifndef PARAMS_LIB
+#define PARAMS_LIB 1
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Wait-free parameter snapshot exchange between one control thread and the
+// audio thread.
+//
+// The owner keeps three parameter structs. The control thread fills the
+// back slot and publishes it by swapping it with the middle slot; the audio
+// thread, at a block boundary, swaps its front slot with the middle slot if
+// a fresh snapshot is waiting. Each side only ever touches the slot it owns,
+// so a snapshot is never torn, and both sides finish in a single atomic
+// exchange without locks or retries.
+
+#define PARAMS_SLOTS 3
+#define PARAMS_FRESH 0x80
+
+typedef struct ParamExchange {
+  _Atomic uint8_t middle;  // slot index, | PARAMS_FRESH when unread
+  uint8_t back;            // owned by the control thread
+  uint8_t front;           // owned by the audio thread
+} ParamExchange;
+
+static inline void ParamExchange_init(ParamExchange *x) {
+  x->back = 0;
+  atomic_init(&x->middle, 1);
+  x->front = 2;
+}
+
+// Control thread: slot to fill before calling ParamExchange_publish
+static inline uint8_t ParamExchange_back(ParamExchange *x) { return x->back; }
+
+// Control thread: hand the filled back slot to the audio thread
+static inline void ParamExchange_publish(ParamExchange *x) {
+  x->back = atomic_exchange_explicit(&x->middle, x->back | PARAMS_FRESH,
+                                     memory_order_acq_rel) &
+            ~PARAMS_FRESH;
+}
+
+// Audio thread: take the newest snapshot if there is one. Returns true when
+// the front slot changed.
+static inline bool ParamExchange_acquire(ParamExchange *x) {
+  if (!(atomic_load_explicit(&x->middle, memory_order_relaxed) &
+        PARAMS_FRESH)) {
+    return false;
+  }
+  x->front = atomic_exchange_explicit(&x->middle, x->front,
+                                      memory_order_acq_rel) &
+             ~PARAMS_FRESH;
+  return true;
+}
+
+// Audio thread: slot holding the current snapshot
+static inline uint8_t ParamExchange_front(ParamExchange *x) {
+  return x->front;
+}
+
+#endif
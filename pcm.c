@@ -0,0 +1,179 @@
+/*
+Float to PCM output stage
+
+Every kernel works on groups of four frames. With SSE2 a group is one vector
+per channel: scale, add dither, clamp, round to nearest and, for 16-bit,
+pack and interleave. Without SSE2, and for the last frames that do not fill
+a group, the scalar loop performs exactly the same float operations in the
+same order, so both builds write identical files.
+
+Dither is triangular (TPDF): the sum of two uniform values in [-0.5, 0.5)
+LSB from a xorshift32 generator. Frame k of a group draws from lane k, the
+left channel first.
+*/
+
+#include "pcm.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define PCM16_SCALE 32767.0f
+#define PCM24_SCALE 8388607.0f
+
+void PcmDither_init(PcmDither* d, uint32_t seed) {
+  for (int i = 0; i < 4; i++) {
+    // xorshift32 must not start at 0
+    d->state[i] = (seed + i) * 2654435761u | 1;
+  }
+}
+
+/* Uniform in [-0.5, 0.5), from the top 23 bits of the next state */
+static inline float uniform(uint32_t* state) {
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  union {
+    uint32_t u;
+    float f;
+  } v = {(x >> 9) | 0x3f800000};  // [1, 2)
+  return v.f - 1.5f;
+}
+
+static inline int32_t quantize(float x, float scale, PcmDither* d, int lane) {
+  float y = x * scale;
+  if (d) {
+    float t = uniform(&d->state[lane]);
+    t += uniform(&d->state[lane]);
+    y += t;
+  }
+  // NaN ends up at negative full scale, as with _mm_max_ps
+  y = fmaxf(y, -scale - 1);
+  y = fminf(y, scale);
+  return (int32_t)lrintf(y);
+}
+
+#ifdef __SSE2__
+static inline __m128 uniform4(__m128i* state) {
+  __m128i x = *state;
+  x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+  x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+  x = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+  *state = x;
+  __m128i bits = _mm_or_si128(_mm_srli_epi32(x, 9), _mm_set1_epi32(0x3f800000));
+  return _mm_sub_ps(_mm_castsi128_ps(bits), _mm_set1_ps(1.5f));
+}
+
+static inline __m128i quantize4(const float* in, float scale, __m128i* lanes) {
+  __m128 y = _mm_mul_ps(_mm_loadu_ps(in), _mm_set1_ps(scale));
+  if (lanes) {
+    __m128 t = uniform4(lanes);
+    t = _mm_add_ps(t, uniform4(lanes));
+    y = _mm_add_ps(y, t);
+  }
+  y = _mm_max_ps(y, _mm_set1_ps(-scale - 1));
+  y = _mm_min_ps(y, _mm_set1_ps(scale));
+  return _mm_cvtps_epi32(y);  // round to nearest, like lrintf
+}
+#endif
+
+void Pcm_from_float16(int16_t* out, const float* left, const float* right,
+                      uint32_t frames, PcmDither* dither) {
+  uint32_t i = 0;
+#ifdef __SSE2__
+  __m128i lanes, *l = NULL;
+  if (dither) {
+    lanes = _mm_loadu_si128((const __m128i*)dither->state);
+    l = &lanes;
+  }
+  if (right) {
+    for (; i + 4 <= frames; i += 4) {
+      __m128i a = quantize4(left + i, PCM16_SCALE, l);
+      __m128i b = quantize4(right + i, PCM16_SCALE, l);
+      __m128i lr = _mm_packs_epi32(a, b);  // l0..l3 r0..r3
+      lr = _mm_unpacklo_epi16(lr, _mm_srli_si128(lr, 8));
+      _mm_storeu_si128((__m128i*)(out + i * 2), lr);
+    }
+  } else {
+    for (; i + 4 <= frames; i += 4) {
+      __m128i a = quantize4(left + i, PCM16_SCALE, l);
+      _mm_storel_epi64((__m128i*)(out + i), _mm_packs_epi32(a, a));
+    }
+  }
+  if (dither) _mm_storeu_si128((__m128i*)dither->state, lanes);
+#endif
+  for (; i < frames; i++) {
+    int lane = i & 3;
+    if (right) {
+      out[i * 2] = quantize(left[i], PCM16_SCALE, dither, lane);
+      out[i * 2 + 1] = quantize(right[i], PCM16_SCALE, dither, lane);
+    } else {
+      out[i] = quantize(left[i], PCM16_SCALE, dither, lane);
+    }
+  }
+}
+
+static inline void store24(uint8_t* p, int32_t x) {
+  p[0] = x;
+  p[1] = x >> 8;
+  p[2] = x >> 16;
+}
+
+void Pcm_from_float24(uint8_t* out, const float* left, const float* right,
+                      uint32_t frames, PcmDither* dither) {
+  int channels = right ? 2 : 1;
+  uint32_t i = 0;
+#ifdef __SSE2__
+  __m128i lanes, *l = NULL;
+  if (dither) {
+    lanes = _mm_loadu_si128((const __m128i*)dither->state);
+    l = &lanes;
+  }
+  int32_t a[4], b[4];
+  for (; i + 4 <= frames; i += 4) {
+    _mm_storeu_si128((__m128i*)a, quantize4(left + i, PCM24_SCALE, l));
+    if (right) {
+      _mm_storeu_si128((__m128i*)b, quantize4(right + i, PCM24_SCALE, l));
+    }
+    for (int k = 0; k < 4; k++) {
+      uint8_t* p = out + (i + k) * channels * 3;
+      store24(p, a[k]);
+      if (right) store24(p + 3, b[k]);
+    }
+  }
+  if (dither) _mm_storeu_si128((__m128i*)dither->state, lanes);
+#endif
+  for (; i < frames; i++) {
+    int lane = i & 3;
+    uint8_t* p = out + i * channels * 3;
+    store24(p, quantize(left[i], PCM24_SCALE, dither, lane));
+    if (right) store24(p + 3, quantize(right[i], PCM24_SCALE, dither, lane));
+  }
+}
+
+void Pcm_from_float32(float* out, const float* left, const float* right,
+                      uint32_t frames) {
+  if (!right) {
+    memcpy(out, left, frames * sizeof(float));
+    return;
+  }
+  uint32_t i = 0;
+#ifdef __SSE2__
+  for (; i + 4 <= frames; i += 4) {
+    __m128 l = _mm_loadu_ps(left + i);
+    __m128 r = _mm_loadu_ps(right + i);
+    _mm_storeu_ps(out + i * 2, _mm_unpacklo_ps(l, r));
+    _mm_storeu_ps(out + i * 2 + 4, _mm_unpackhi_ps(l, r));
+  }
+#endif
+  for (; i < frames; i++) {
+    out[i * 2] = left[i];
+    out[i * 2 + 1] = right[i];
+  }
+}
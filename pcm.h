@@ -0,0 +1,21 @@
+#include <stdint.h>
+
+/* TPDF dither generator: four xorshift32 lanes, one per SIMD lane */
+typedef struct PcmDither {
+  uint32_t state[4];
+} PcmDither;
+
+void PcmDither_init(PcmDither* d, uint32_t seed);
+
+/* Convert planar float in [-1, 1] to interleaved PCM. Pass right = NULL for
+   mono. Integer formats saturate at full scale instead of wrapping, and are
+   dithered with triangular noise of +-1 LSB unless dither is NULL. The SSE2
+   and scalar builds produce identical output. */
+void Pcm_from_float16(int16_t* out, const float* left, const float* right,
+                      uint32_t frames, PcmDither* dither);
+void Pcm_from_float24(uint8_t* out, const float* left, const float* right,
+                      uint32_t frames, PcmDither* dither);
+
+/* Interleave planar float, values are passed through unclipped */
+void Pcm_from_float32(float* out, const float* left, const float* right,
+                      uint32_t frames);
@@ -0,0 +1,53 @@
+#ifndef REVERB_H
+#define REVERB_H 1
+
+// Build-time reverb engine selection
+//
+// Both engines expose the same create / set / process_block surface, so the
+// renderer only talks to Reverb_*. Build with REVERB=fdn (-DREVERB_FDN) to
+// swap the Dattorro plate for the 8-line feedback delay network.
+//
+// The mapping is not one to one: the FDN has no decay diffusion setting,
+// so under REVERB=fdn Reverb_setDecayDiffusion is accepted and does
+// nothing. A patch tuned on the plate's decay diffusion sounds different
+// on the FDN.
+
+#ifdef REVERB_FDN
+
+#include "fdnverb.h"
+
+typedef struct sFdnVerb Reverb;
+#define REVERB_NAME "fdn"
+#define Reverb_create FdnVerb_create
+#define Reverb_delete FdnVerb_delete
+#define Reverb_clear FdnVerb_clear
+#define Reverb_setPreDelay FdnVerb_setPreDelay
+#define Reverb_setPreFilter FdnVerb_setPreFilter
+#define Reverb_setInputDiffusion1 FdnVerb_setInputDiffusion1
+#define Reverb_setInputDiffusion2 FdnVerb_setInputDiffusion2
+#define Reverb_setDecayDiffusion FdnVerb_setDecayDiffusion  // no-op
+#define Reverb_setDecay FdnVerb_setDecay
+#define Reverb_setDamping FdnVerb_setDamping
+#define Reverb_process_block FdnVerb_process_block
+
+#else
+
+#include "verb.h"
+
+typedef struct sDattorroVerb Reverb;
+#define REVERB_NAME "dattorro"
+#define Reverb_create DattorroVerb_create
+#define Reverb_delete DattorroVerb_delete
+#define Reverb_clear DattorroVerb_clear
+#define Reverb_setPreDelay DattorroVerb_setPreDelay
+#define Reverb_setPreFilter DattorroVerb_setPreFilter
+#define Reverb_setInputDiffusion1 DattorroVerb_setInputDiffusion1
+#define Reverb_setInputDiffusion2 DattorroVerb_setInputDiffusion2
+#define Reverb_setDecayDiffusion DattorroVerb_setDecayDiffusion
+#define Reverb_setDecay DattorroVerb_setDecay
+#define Reverb_setDamping DattorroVerb_setDamping
+#define Reverb_process_block DattorroVerb_process_block
+
+#endif
+
+#endif
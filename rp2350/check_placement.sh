@@ -0,0 +1,82 @@
+#!/bin/sh
+# Check that the render loop runs from SRAM (see placement.h).
+#
+# Starting from core1_main, follows every call and tail call in the
+# disassembly and reports each function reached, with its address and the
+# section the map file linked it into. Fails if any of them is in flash
+# (0x10xxxxxx), or is reached through a long-branch veneer, which from SRAM
+# only exists to get to flash.
+#
+# usage: ./check_placement.sh [build/hello_usb.elf.map] [build/hello_usb.dis]
+
+MAP=${1:-build/hello_usb.elf.map}
+DIS=${2:-build/hello_usb.dis}
+ROOTS="core1_main"
+
+for f in "$MAP" "$DIS"; do
+  if [ ! -f "$f" ]; then
+    echo "missing $f, build first" >&2
+    exit 2
+  fi
+done
+
+awk -v roots="$ROOTS" '
+  # map: remember the input section each symbol was linked from
+  FILENAME == ARGV[1] {
+    if ($0 ~ /^ \.[^ ]/) section = $1
+    else if (NF == 2 && $1 ~ /^0x/ && $2 !~ /^0x/) where[$2] = section
+    next
+  }
+
+  # disassembly: function headers and the calls out of each function
+  /^[0-9a-f]+ <[^>]+>:$/ {
+    fn = substr($2, 2, length($2) - 3)
+    addr[fn] = $1
+    next
+  }
+  fn != "" {
+    n = split($0, col, "\t")
+    if (n < 4) next
+    op = col[3]
+    sub(/ +$/, "", op)
+    if (op !~ /^(bl|b|b\.w|b\.n)$/) next
+    if (!match(col[4], /<[^>]+>$/)) next
+    target = substr(col[4], RSTART + 1, RLENGTH - 2)
+    if (target ~ /\+0x/ || target == fn) next
+    calls[fn] = calls[fn] " " target
+  }
+
+  END {
+    n = split(roots, queue, " ")
+    for (i = 1; i <= n; i++) seen[queue[i]] = 1
+    bad = 0
+    for (i = 1; i <= n; i++) {
+      f = queue[i]
+      a = (f in addr) ? addr[f] : "?"
+      s = (f in where) ? where[f] : "?"
+      status = "ok"
+      if (f ~ /_veneer$/) {
+        status = "FLASH"
+        target = f
+        sub(/^__/, "", target)
+        sub(/_veneer$/, "", target)
+        s = (target in where) ? where[target] : "?"
+      } else if (a !~ /^2/) {
+        status = "FLASH"
+      }
+      if (status != "ok") bad++
+      printf "%-6s %-9s %-36s %s\n", status, a, f, s
+      # do not follow into flash, the caller is already reported
+      if (status != "ok") continue
+      m = split(calls[f], next_calls, " ")
+      for (j = 1; j <= m; j++) {
+        if (!(next_calls[j] in seen)) {
+          seen[next_calls[j]] = 1
+          queue[++n] = next_calls[j]
+        }
+      }
+    }
+    printf "%d functions reached from %s, %d in flash\n", n, roots, bad
+    exit bad > 0
+  }
+' "$MAP" "$DIS"
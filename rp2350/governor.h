@@ -0,0 +1,57 @@
+#ifndef GOVERNOR_LIB
+#define GOVERNOR_LIB 1
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// CPU load governor
+//
+// Watches the render time of every block against the block's deadline and
+// picks a degradation level, 0 being full quality. The caller decides what
+// each level gives up, cheapest sacrifice first. The level steps up at once
+// when a block comes close to the deadline or the smoothed load is high,
+// and steps down only after the smoothed load has stayed low for a while.
+// The gap between the two thresholds plus the hold time keeps it from
+// flapping between two levels.
+
+#define GOVERNOR_LEVELS 5
+#define GOVERNOR_PEAK 0.9f  // a single block above this steps up
+#define GOVERNOR_HIGH 0.8f  // smoothed load above this steps up
+#define GOVERNOR_LOW 0.6f   // smoothed load below this may step down
+#define GOVERNOR_HOLD 200   // blocks below GOVERNOR_LOW before stepping down
+
+typedef struct Governor {
+  uint8_t level;  // 0 = full quality
+  float load;     // smoothed render time / deadline
+  uint16_t calm;  // consecutive blocks below GOVERNOR_LOW
+} Governor;
+
+static inline void Governor_init(Governor *g) {
+  g->level = 0;
+  g->load = 0;
+  g->calm = 0;
+}
+
+// Feed the render time of a block and its deadline, in the same unit.
+// Returns the level to use for the next block.
+static inline uint8_t Governor_update(Governor *g, uint32_t ticks,
+                                      uint32_t deadline) {
+  float load = (float)ticks / deadline;
+  g->load += (load - g->load) * 0.125f;
+  if (load > GOVERNOR_PEAK || g->load > GOVERNOR_HIGH) {
+    g->calm = 0;
+    if (g->level + 1 < GOVERNOR_LEVELS) g->level++;
+    // give the new level a chance to show its cost before judging again
+    g->load = GOVERNOR_LOW;
+  } else if (g->load < GOVERNOR_LOW) {
+    if (++g->calm >= GOVERNOR_HOLD && g->level > 0) {
+      g->level--;
+      g->calm = 0;
+    }
+  } else {
+    g->calm = 0;
+  }
+  return g->level;
+}
+
+#endif
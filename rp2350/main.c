@@ -24,82 +24,87 @@ void print_memory_usage() {
   uint32_t total_heap = getTotalHeap();
   uint32_t used_heap = total_heap - getFreeHeap();
   printf("memory usage: %2.1f%% (%ld/%ld)\n",
-         (float)(used_heap) / (float)(total_heap) * 100.0, used_heap,
+         (double)used_heap / total_heap * 100.0, used_heap,
          total_heap);
 }
 
 #include "hardware/clocks.h"
+#include "pico/multicore.h"
 #include "pico/stdlib.h"
 
 #define ONBOARD_LED 25
 
 #include "adsr.h"
+#include "blockstats.h"
+#include "governor.h"
+#include "placement.h"
+#include "sawbank.h"
+#include "telemetry.h"
 #include "verb.h"
 
 const int block_size = 8192;
 
-// create a saw wave struct
-typedef struct LFSaw {
-  float phase;
-  float sample_rate;
-  float amplitude;
-  float phase_increment;
-} LFSaw;
-
-void LFSaw_init(LFSaw *saw, float freq, float sample_rate, float amplitude) {
-  // choose random phase
-  saw->phase = (float)rand() / RAND_MAX;
-  saw->sample_rate = sample_rate;
-  saw->amplitude = amplitude;
-  saw->phase_increment = freq / sample_rate;
-}
-
-void LFSaw_set_freq(LFSaw *saw, float freq) {
-  saw->phase_increment = freq / saw->sample_rate;
-}
-
-float __not_in_flash_func(LFSaw_next_sample)(LFSaw *saw) {
-  float next = saw->phase * saw->amplitude;
-  saw->phase += saw->phase_increment;
-  if (saw->phase >= 1) {
-    saw->phase -= 2;
-  }
-  return next;
-}
-
+// unison saws, rendered SAW_BLOCK samples ahead on the interpolator and
+// consumed one per sample. The saws are kept loudest first, so the load
+// governor can drop the quietest ones by lowering count. Saws dropped or
+// restored fade out or in over the next block rather than cutting.
 typedef struct LFSaws {
-  LFSaw saws[7];
+  SawBank bank;  // bank.count: saws rendered in the current block
+  int32_t block[SAW_BLOCK];
+  uint8_t pos;    // next sample of block
+  uint8_t count;  // saws wanted from the next block on
 } LFSaws;
 
 float detuneCurve(float x) {
-  return (10028.7312891634 * pow(x, 11)) - (50818.8652045924 * pow(x, 10)) +
-         (111363.4808729368 * pow(x, 9)) - (138150.6761080548 * pow(x, 8)) +
-         (106649.6679158292 * pow(x, 7)) - (53046.9642751875 * pow(x, 6)) +
-         (17019.9518580080 * pow(x, 5)) - (3425.0836591318 * pow(x, 4)) +
-         (404.2703938388 * pow(x, 3)) - (24.1878824391 * pow(x, 2)) +
-         (0.6717417634 * x) + 0.0030115596;
+  // the fitted polynomial, expanded around x = 0.5 so that evaluating it in
+  // float does not cancel: within 1.2e-6 of the original on [0, 1]
+  static const float coefficients[12] = {
+      0.0979551523f, 0.261076015f, 1.20727185f,  4.75063955f,
+      -18.6035476f,  -81.164784f,  280.892017f,  877.89611f,
+      -1884.66289f,  -4835.78992f, 4339.15689f,  10028.7313f};
+  float u = x - 0.5f;
+  float y = 0;
+  for (int k = 11; k >= 0; k--) y = y * u + coefficients[k];
+  return y;
 }
 
 float detuneAmounts[7] = {-0.11002313, -0.06288439, -0.01952356, 0,
                           0.01991221,  0.06216538,  0.10745242};
 
 float amplitudeAmounts[7] = {0.5, 0.3, 0.4, 0.8, 0.8, 0.4, 0.3};
+// indices into the tables above, loudest first
+uint8_t loudnessOrder[7] = {3, 4, 0, 2, 5, 1, 6};
 void LFSaws_init(LFSaws *saws, float freq, float sample_rate) {
   float detuneFactor = freq * detuneCurve(0.5);
   // print to stderr
-  fprintf(stderr, "detuneFactor: %f\n", detuneFactor);
+  fprintf(stderr, "detuneFactor: %f\n", (double)detuneFactor);
   for (int i = 0; i < 7; i++) {
-    LFSaw_init(&saws->saws[i], freq + detuneFactor * detuneAmounts[i],
-               sample_rate, amplitudeAmounts[i] / 4.0);
+    int k = loudnessOrder[i];
+    // phase runs over [-1, 1) as int32_t, so 2^31 per unit
+    float increment = (freq + detuneFactor * detuneAmounts[k]) / sample_rate;
+    // choose random phase
+    saws->bank.phase[i] = (float)rand() / RAND_MAX * 2147483648.0f;
+    saws->bank.increment[i] = increment * 2147483648.0f;
+    saws->bank.amplitude[i] = amplitudeAmounts[k] / 4.0f * 32768;
   }
+  saws->count = 7;
+  saws->bank.count = 7;
+  saws->pos = SAW_BLOCK;
 }
 
-float __not_in_flash_func(LFSaws_next_sample)(LFSaws *saws) {
-  float next = 0;
-  for (int i = 0; i < 7; i++) {
-    next += LFSaw_next_sample(&saws->saws[i]);
+float HOT_FUNC(LFSaws_next_sample)(LFSaws *saws) {
+  if (saws->pos == SAW_BLOCK) {
+    uint8_t from = saws->bank.count, to = saws->count;
+    // saws in both counts at full level, the others ramp
+    saws->bank.count = from < to ? from : to;
+    SawBank_render(&saws->bank, saws->block, SAW_BLOCK);
+    for (int s = saws->bank.count; s < from || s < to; s++) {
+      SawBank_render_ramp(&saws->bank, saws->block, s, to > from);
+    }
+    saws->bank.count = to;
+    saws->pos = 0;
   }
-  return next;
+  return saws->block[saws->pos++] * (1.0f / (1 << 30));
 }
 
 typedef struct WhiteNoise {
@@ -110,8 +115,19 @@ void WhiteNoise_init(WhiteNoise *noise, float amplitude) {
   noise->amplitude = amplitude;
 }
 
-float WhiteNoise_next_sample(WhiteNoise *noise) {
-  return ((float)rand() / RAND_MAX - 0.5) * noise->amplitude;
+// xorshift32 for the render loop, which must not call into newlib's rand
+// in flash. Uniform in [0, 1).
+static uint32_t randomState CORE1_DATA = 2463534242;
+
+float HOT_FUNC(Random_next)(void) {
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 17;
+  randomState ^= randomState << 5;
+  return (randomState >> 8) * (1.0f / (1 << 24));
+}
+
+float HOT_FUNC(WhiteNoise_next_sample)(WhiteNoise *noise) {
+  return (Random_next() - 0.5f) * noise->amplitude;
 }
 
 typedef struct OnePole {
@@ -119,8 +135,8 @@ typedef struct OnePole {
 } OnePole;
 
 // out(i) = ((1 - abs(coef)) * in(i)) + (coef * out(i-1)).
-float __not_in_flash_func(OnePole_next)(OnePole *self, float in, float coef) {
-  float out = ((1 - fabs(coef)) * in) + (coef * self->prev_out);
+float HOT_FUNC(OnePole_next)(OnePole *self, float in, float coef) {
+  float out = ((1 - fabsf(coef)) * in) + (coef * self->prev_out);
   self->prev_out = out;
   return out;
 }
@@ -131,35 +147,128 @@ typedef struct Voice {
   ADSR adsr;
   WhiteNoise noise;
   float amp;
+  float release;  // seconds, restored after a steal
 } Voice;
 
+// release time of a voice stolen by the load governor
+#define VOICE_STEAL_RELEASE 0.005f
+
 void Voice_init(Voice *voice, float freq, float amp, float sample_rate) {
   voice->amp = amp;
+  voice->release = 0.5;
   // WhiteNoise_init(&voice->noise, 0.05);
   LFSaws_init(&voice->saws, freq, sample_rate);
   ADSR_init(&voice->adsr, 4, 1, 0.707, 0.5, 2.0, 48000);
 }
 
-float Voice_next_sample(Voice *voice) {
+float HOT_FUNC(Voice_next_sample)(Voice *voice) {
   float sample = 0;
   sample += LFSaws_next_sample(&voice->saws);
   sample += WhiteNoise_next_sample(&voice->noise);
   // generate random number between 0.97 and 0.99
-  float random = (float)rand() / RAND_MAX * 0.15 + 0.8;
+  float random = Random_next() * 0.15f + 0.8f;
   sample = OnePole_next(&voice->one_pole, sample, random);
   sample = sample * ADSR_process(&voice->adsr);
   sample = sample * voice->amp;
   return sample;
 }
 
-void Voice_gate(Voice *voice, bool gate) { ADSR_gate(&voice->adsr, gate); }
+void Voice_gate(Voice *voice, bool gate) {
+  if (gate) ADSR_set_release(&voice->adsr, voice->release);
+  ADSR_gate(&voice->adsr, gate);
+}
 
 void Voice_set_release(Voice *voice, float release) {
+  voice->release = release;
   ADSR_set_release(&voice->adsr, release);
 }
 
+// Finish a releasing voice within a few ms, continuing from its current
+// level so there is no click. Returns true if the voice was releasing.
+bool HOT_FUNC(Voice_steal)(Voice *voice) {
+  ADSR *adsr = &voice->adsr;
+  if (adsr->state != env_release) return false;
+  if (adsr->release > VOICE_STEAL_RELEASE * adsr->sample_rate) {
+    adsr->level_release = adsr->level;
+    adsr->sample_counter = 0;
+    ADSR_set_release(adsr, VOICE_STEAL_RELEASE);
+  }
+  return true;
+}
+
 float buffer[1000];
 
+// samples per timed block, as the audio callback would render them
+#define STATS_BLOCK 256
+
+#define NUM_VOICES 3
+static Voice voice[NUM_VOICES] CORE1_DATA;
+static struct sDattorroVerb *verb;
+
+// render time of every voice + reverb block in us
+static BlockStats stats;
+// one record per block from core1, printed by core0
+static Telemetry telemetry;
+
+// unison saws per voice at each load governor level
+uint8_t governorUnison[GOVERNOR_LEVELS] = {7, 7, 7, 5, 3};
+
+// Shed work for a governor level, cheapest sacrifice first: 1 finishes
+// releasing voices within a few ms, 2 switches the reverb to its lite mode,
+// 3 and 4 drop the quietest unison saws of every voice. Both fade over a
+// block rather than cut, so shedding does not click
+void HOT_FUNC(apply_governor)(uint8_t level) {
+  for (int j = 0; j < NUM_VOICES; j++) {
+    if (level >= 1) Voice_steal(&voice[j]);
+    voice[j].saws.count = governorUnison[level];
+  }
+  DattorroVerb_setLite(verb, level >= 2);
+}
+
+// Audio core: renders blocks of voices + reverb back to back and reports
+// each one through the telemetry ring. It never prints, so waiting on the
+// USB serial port cannot show up in its timings. The load governor sheds
+// work when blocks come close to the deadline.
+void HOT_FUNC(core1_main)() {
+  float block[STATS_BLOCK];
+  uint32_t n = 0;
+  uint32_t deadline = STATS_BLOCK * 1000000ull / 48000;
+  Governor governor;
+  Governor_init(&governor);
+  // the saws render on this core's interpolator
+  SawBank_init_interp();
+  while (true) {
+    apply_governor(governor.level);
+    TelemetryRecord r = {
+        .block = n++, .frames = STATS_BLOCK, .shed = governor.level};
+    uint32_t block_start = time_us_32();
+    for (int i = 0; i < STATS_BLOCK; i++) {
+      float sample = 0;
+      for (int j = 0; j < NUM_VOICES; j++)
+        sample += Voice_next_sample(&voice[j]) / NUM_VOICES;
+      block[i] = sample;
+    }
+    uint32_t voices_done = time_us_32();
+    r.min = r.max = 0;
+    for (int i = 0; i < STATS_BLOCK; i++) {
+      DattorroVerb_process(verb, block[i]);
+      float sampleL = DattorroVerb_getLeft(verb);
+      float sampleR = DattorroVerb_getRight(verb);
+      buffer[i % 1000] = sampleL + sampleR;
+      if (buffer[i % 1000] < r.min) r.min = buffer[i % 1000];
+      if (buffer[i % 1000] > r.max) r.max = buffer[i % 1000];
+    }
+    r.ticks = time_us_32() - block_start;
+    r.voice_ticks = voices_done - block_start;
+    for (int j = 0; j < NUM_VOICES; j++) {
+      if (voice[j].adsr.state != env_idle) r.voices++;
+    }
+    BlockStats_record(&stats, r.ticks);
+    Telemetry_push(&telemetry, &r);
+    Governor_update(&governor, r.ticks, deadline);
+  }
+}
+
 int main() {
   // overclock
   set_sys_clock_khz(240000, true);
@@ -172,7 +281,7 @@ int main() {
   sleep_ms(1000);
 
   // reverb
-  struct sDattorroVerb *verb = DattorroVerb_create();
+  verb = DattorroVerb_create();
   // giant reverb
   DattorroVerb_setPreDelay(verb, 0.2);
   DattorroVerb_setPreFilter(verb, 0.9);
@@ -182,8 +291,8 @@ int main() {
   DattorroVerb_setDecay(verb, 0.9);
   DattorroVerb_setDamping(verb, 0.3);
 
-#define NUM_VOICES 3
-  Voice voice[NUM_VOICES];
+  SawBank_init_table();
+
   // overtone series
   float freqs[7] = {110, 220, 440, 55, 1760, 3520, 7040};
   float amps[7] = {0.75, 0.5, 0.25, 0.25, 0.125, 0.0625, 0.03125};
@@ -193,54 +302,38 @@ int main() {
     Voice_set_release(&voice[i], 0.1);
   }
 
-  // print total memory
+  BlockStats_init(&stats, STATS_BLOCK * 1000000ull / 48000);
+  Telemetry_init(&telemetry);
+  multicore_launch_core1(core1_main);
 
+  // core0 blinks, and sums and prints what core1 reports every second
+  TelemetryRecord r;
+  uint64_t frames = 0, ticks = 0, voice_ticks = 0;
   while (true) {
-    print_memory_usage();
-    gpio_put(ONBOARD_LED, 1);
-    sleep_ms(500);
-    gpio_put(ONBOARD_LED, 0);
-    sleep_ms(500);
-
-    float total_samples = 48000;
-    // start time
-    uint64_t start_time = time_us_64();
-    for (int i = 0; i < total_samples; i++) {
-      float sample = 0;
-      for (int j = 0; j < NUM_VOICES; j++)
-        sample += Voice_next_sample(&voice[j]) / NUM_VOICES;
-      if (i == 48000 * 5) {
-        for (int j = 0; j < NUM_VOICES; j++) Voice_gate(&voice[j], false);
-      }
-      buffer[i % 1000] = sample;
+    if (!Telemetry_pop(&telemetry, &r)) {
+      gpio_put(ONBOARD_LED, (time_us_32() >> 19) & 1);
+      continue;
     }
-    // end time
-    uint64_t end_time = time_us_64();
-    float total_time = (float)(end_time - start_time);
-    float us_per_voice =
-        (float)(end_time - start_time) / total_samples / NUM_VOICES;
-
-    // start time
-    start_time = time_us_64();
-    for (int i = 0; i < total_samples; i++) {
-      float sample = 0;
-      for (int j = 0; j < NUM_VOICES; j++)
-        sample += Voice_next_sample(&voice[j]) / NUM_VOICES;
-      if (i == 48000 * 5) {
-        for (int j = 0; j < NUM_VOICES; j++) Voice_gate(&voice[j], false);
-      }
-      DattorroVerb_process(verb, sample);
-      float sampleL = DattorroVerb_getLeft(verb);
-      float sampleR = DattorroVerb_getRight(verb);
-      buffer[i % 1000] = sampleL + sampleR;
-    }
-    // end time
-    end_time = time_us_64();
-    float us_per_reverb =
-        ((end_time - start_time) - total_time) / total_samples;
-    printf("us per voice: %2.1f\n", us_per_voice);
-    printf("us per reverb: %2.1f\n", us_per_reverb);
-    printf("%% of block: %2.1f%%\n", ((end_time - start_time) / total_samples) /
-                                         (1000000.0f / 48000.0f) * 100.0f);
+    frames += r.frames;
+    ticks += r.ticks;
+    voice_ticks += r.voice_ticks;
+    if (frames < 48000) continue;
+
+    float us_per_voice = (float)voice_ticks / frames / NUM_VOICES;
+    float us_per_reverb = (float)(ticks - voice_ticks) / frames;
+    print_memory_usage();
+    printf("us per voice: %2.1f\n", (double)us_per_voice);
+    printf("us per reverb: %2.1f\n", (double)us_per_reverb);
+    printf("%% of block: %2.1f%%\n",
+           (double)ticks / frames / (1000000.0 / 48000.0) * 100.0);
+    BlockStatsSnapshot snapshot;
+    BlockStats_snapshot(&stats, &snapshot, true);
+    printf("block us: mean %lu, p99 < %lu, max %lu, %lu/%lu over %lu\n",
+           BlockStats_mean(&snapshot), BlockStats_percentile(&snapshot, 0.99f),
+           snapshot.max, snapshot.misses, snapshot.blocks, snapshot.deadline);
+    printf("voices: %u, level: %.3f..%.3f, shed: %u, dropped: %lu\n",
+           r.voices, (double)r.min, (double)r.max, r.shed,
+           Telemetry_dropped(&telemetry));
+    frames = ticks = voice_ticks = 0;
   }
-}
\ No newline at end of file
+}
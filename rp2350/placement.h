@@ -0,0 +1,31 @@
+#ifndef PLACEMENT_LIB
+#define PLACEMENT_LIB 1
+
+// SRAM placement policy
+//
+// Code run by the render loop must not execute from XIP flash: a cache miss
+// stalls the core for the whole flash fetch, and a flash write elsewhere
+// stalls it entirely.
+//
+// - HOT_FUNC(f): every function the render loop calls, per sample or per
+//   block. Goes to .time_critical, which crt0 copies to SRAM at boot.
+// - CORE1_DATA: small state only the audio core touches (voices, its
+//   random generator). Goes to SCRATCH_X, the 4K bank core1's stack
+//   already lives in, so it never contends with core0.
+// - SCRATCH_Y holds core0's stack and is left to it.
+// - Large buffers (reverb delay lines, the saw table) stay in main SRAM,
+//   which is striped word by word across its eight banks, so their
+//   accesses spread over all of them.
+//
+// check_placement.sh verifies the linked image against this.
+
+#if PICO_ON_DEVICE
+#include "pico.h"
+#define HOT_FUNC(f) __not_in_flash_func(f)
+#define CORE1_DATA __scratch_x("core1")
+#else
+#define HOT_FUNC(f) f
+#define CORE1_DATA
+#endif
+
+#endif
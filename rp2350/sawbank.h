@@ -0,0 +1,166 @@
+#ifndef SAWBANK_LIB
+#define SAWBANK_LIB 1
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Integer unison saw bank on the SIO interpolator
+//
+// Each saw is a 32-bit phase accumulator read through a wavetable. The
+// interpolator does the per-sample work in hardware: lane 0 adds the
+// increment to the phase (ADD_RAW), and lane 1 reads the same phase
+// (CROSS_INPUT) and shifts and masks it down to a table index. One POP of
+// lane 1 returns the index of the current phase and writes the advanced
+// phase back, so a sample is a register read, a table load and a
+// multiply-accumulate. Saws are rendered one at a time over a whole block,
+// so the interpolator is loaded once per saw per block, not per sample.
+//
+// interp0 is per core and must only be used by the core that renders.
+// On the host the interpolator is a register-level model of the subset
+// used here, driven by the same control words, so SawBank_render can be
+// checked bit for bit against SawBank_render_soft.
+
+#define SAW_UNISON 7
+#define SAW_TABLE_BITS 11
+#define SAW_TABLE_SIZE (1 << SAW_TABLE_BITS)
+#define SAW_BLOCK_BITS 5
+#define SAW_BLOCK (1 << SAW_BLOCK_BITS)  // samples rendered per refill
+
+// Interpolator lane control bits, as laid out in the CTRL_LANEx registers
+#define SAW_CTRL_SHIFT_LSB 0
+#define SAW_CTRL_MASK_LSB_LSB 5
+#define SAW_CTRL_MASK_MSB_LSB 10
+#define SAW_CTRL_SIGNED (1u << 15)
+#define SAW_CTRL_CROSS_INPUT (1u << 16)
+#define SAW_CTRL_CROSS_RESULT (1u << 17)
+#define SAW_CTRL_ADD_RAW (1u << 18)
+
+// lane 0: phase += increment
+#define SAW_CTRL_LANE0 (SAW_CTRL_ADD_RAW | (31u << SAW_CTRL_MASK_MSB_LSB))
+// lane 1: index = phase >> (32 - SAW_TABLE_BITS)
+#define SAW_CTRL_LANE1                                        \
+  (SAW_CTRL_CROSS_INPUT |                                     \
+   ((32u - SAW_TABLE_BITS) << SAW_CTRL_SHIFT_LSB) |           \
+   ((SAW_TABLE_BITS - 1u) << SAW_CTRL_MASK_MSB_LSB))
+
+#if PICO_ON_DEVICE
+#include "hardware/interp.h"
+
+typedef interp_hw_t SawInterp;
+#define SAW_INTERP interp0
+
+static inline uint32_t SawInterp_pop1(SawInterp *h) { return h->pop[1]; }
+
+#else
+
+typedef struct SawInterp {
+  uint32_t accum[2];
+  uint32_t base[3];
+  uint32_t ctrl[2];
+} SawInterp;
+
+static SawInterp sawInterpModel;
+#define SAW_INTERP (&sawInterpModel)
+
+// Lane result: shift, mask and sign extend the lane's input, then add its
+// base, or add the unshifted input instead with ADD_RAW
+static inline uint32_t SawInterp_lane(SawInterp *h, int lane) {
+  uint32_t ctrl = h->ctrl[lane];
+  uint32_t input = h->accum[(ctrl & SAW_CTRL_CROSS_INPUT) ? !lane : lane];
+  if (ctrl & SAW_CTRL_ADD_RAW) return input + h->base[lane];
+  uint32_t shift = (ctrl >> SAW_CTRL_SHIFT_LSB) & 31;
+  uint32_t lsb = (ctrl >> SAW_CTRL_MASK_LSB_LSB) & 31;
+  uint32_t msb = (ctrl >> SAW_CTRL_MASK_MSB_LSB) & 31;
+  uint32_t mask = (0xFFFFFFFFu >> (31 - msb)) & (0xFFFFFFFFu << lsb);
+  uint32_t value = (input >> shift) & mask;
+  if ((ctrl & SAW_CTRL_SIGNED) && msb < 31 && (value >> msb) & 1) {
+    value |= 0xFFFFFFFFu << (msb + 1);
+  }
+  return value + h->base[lane];
+}
+
+// Reading POP_LANE1 returns lane 1's result and writes both lane results
+// back to the accumulators (swapped with CROSS_RESULT)
+static inline uint32_t SawInterp_pop1(SawInterp *h) {
+  uint32_t result[2] = {SawInterp_lane(h, 0), SawInterp_lane(h, 1)};
+  for (int lane = 0; lane < 2; lane++) {
+    int to = (h->ctrl[lane] & SAW_CTRL_CROSS_RESULT) ? !lane : lane;
+    h->accum[to] = result[lane];
+  }
+  return result[1];
+}
+
+#endif
+
+// Signed saw: index i covers phases i << (32 - SAW_TABLE_BITS), read as
+// int32_t, so the saw runs from 0 up to full scale, jumps to minus full
+// scale at half phase and rises back to 0
+static int16_t sawTable[SAW_TABLE_SIZE];
+
+typedef struct SawBank {
+  uint32_t phase[SAW_UNISON];
+  uint32_t increment[SAW_UNISON];
+  int32_t amplitude[SAW_UNISON];  // Q15
+  uint8_t count;                  // saws rendered, from the first
+} SawBank;
+
+static inline void SawBank_init_table(void) {
+  for (int i = 0; i < SAW_TABLE_SIZE; i++) {
+    sawTable[i] = (int16_t)(i << (16 - SAW_TABLE_BITS));
+  }
+}
+
+// Set up the calling core's interpolator for SawBank_render
+static inline void SawBank_init_interp(void) {
+  SawInterp *h = SAW_INTERP;
+  h->ctrl[0] = SAW_CTRL_LANE0;
+  h->ctrl[1] = SAW_CTRL_LANE1;
+  h->base[1] = 0;
+}
+
+// out[i] = sum over saws of table value * amplitude, full scale 2^30
+static inline void SawBank_render(SawBank *b, int32_t *out, int n) {
+  SawInterp *h = SAW_INTERP;
+  for (int i = 0; i < n; i++) out[i] = 0;
+  for (int s = 0; s < b->count; s++) {
+    int32_t amplitude = b->amplitude[s];
+    h->accum[0] = b->phase[s];
+    h->base[0] = b->increment[s];
+    for (int i = 0; i < n; i++) {
+      out[i] += sawTable[SawInterp_pop1(h)] * amplitude;
+    }
+    b->phase[s] = h->accum[0];
+  }
+}
+
+// The same in plain C, the reference for SawBank_render
+static inline void SawBank_render_soft(SawBank *b, int32_t *out, int n) {
+  for (int i = 0; i < n; i++) out[i] = 0;
+  for (int s = 0; s < b->count; s++) {
+    int32_t amplitude = b->amplitude[s];
+    uint32_t phase = b->phase[s];
+    for (int i = 0; i < n; i++) {
+      out[i] += sawTable[phase >> (32 - SAW_TABLE_BITS)] * amplitude;
+      phase += b->increment[s];
+    }
+    b->phase[s] = phase;
+  }
+}
+
+// Add saw s to out with its amplitude ramping over the SAW_BLOCK
+// samples, up from 0 if fadeIn, else down to 0, and advance its phase.
+// For saws joining or leaving the bank, so they do not click. Plain C, it
+// only runs for the block in which the saw count changes.
+static inline void SawBank_render_ramp(SawBank *b, int32_t *out, int s,
+                                       bool fadeIn) {
+  uint32_t phase = b->phase[s];
+  for (int i = 0; i < SAW_BLOCK; i++) {
+    int32_t step = fadeIn ? i : SAW_BLOCK - i;
+    int32_t amplitude = (b->amplitude[s] * step) >> SAW_BLOCK_BITS;
+    out[i] += sawTable[phase >> (32 - SAW_TABLE_BITS)] * amplitude;
+    phase += b->increment[s];
+  }
+  b->phase[s] = phase;
+}
+
+#endif
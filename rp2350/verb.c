@@ -40,9 +40,11 @@ My github:     https://github.com/el-visio
 #include <stdlib.h>
 #include <string.h>
 
+#include "placement.h"
 #include "verb_structs.h"
 
 #define MAX_PREDELAY 4800  // 100ms for 48k samplerate
+#define LITE_FADE 256      // samples to switch the lite mode in or out
 
 /* Clamp value between min and max */
 float clamp(float x, float min, float max) {
@@ -96,23 +98,26 @@ void DelayBuffer_delete(DelayBuffer* db) {
 }
 
 /* Write input value into buffer, read delayed output */
-float DelayBuffer_process(DelayBuffer* db, uint16_t t, float in) {
+float HOT_FUNC(DelayBuffer_process)(DelayBuffer* db, uint16_t t,
+                                    float in) {
   db->buffer[t & db->mask] = in;
   return db->buffer[(t + db->readOffset[TAP_MAIN]) & db->mask];
 }
 
 /* Write value into delay buffer */
-void DelayBuffer_write(DelayBuffer* db, uint16_t t, float in) {
+void HOT_FUNC(DelayBuffer_write)(DelayBuffer* db, uint16_t t, float in) {
   db->buffer[t & db->mask] = in;
 }
 
 /* Read delayed output value */
-float DelayBuffer_read(DelayBuffer* db, uint16_t tapId, uint16_t t) {
+float HOT_FUNC(DelayBuffer_read)(DelayBuffer* db, uint16_t tapId,
+                                 uint16_t t) {
   return db->buffer[(t + db->readOffset[tapId]) & db->mask];
 }
 
 /* Apply all-pass filter */
-float AllPassFilter_process(DelayBuffer* db, uint16_t t, float gain, float in) {
+float HOT_FUNC(AllPassFilter_process)(DelayBuffer* db, uint16_t t,
+                                      float gain, float in) {
   float delayed = DelayBuffer_read(db, TAP_MAIN, t);
   in += delayed * -gain;
   DelayBuffer_write(db, t, in);
@@ -120,7 +125,7 @@ float AllPassFilter_process(DelayBuffer* db, uint16_t t, float gain, float in) {
 }
 
 /* Apply Low pass filter */
-float LowPassFilter_process(float* out, float freq, float in) {
+float HOT_FUNC(LowPassFilter_process)(float* out, float freq, float in) {
   *out += (in - *out) * freq;
   return *out;
 }
@@ -153,7 +158,7 @@ void DattorroVerb_setDecayDiffusion(struct sDattorroVerb* v, float value) {
 /* Set decay amount and calculate related decay diffusion 2 amount */
 void DattorroVerb_setDecay(DattorroVerb* v, float value) {
   v->decayAmount = value;
-  v->decayDiffusion2Amount = clamp(value + 0.15, 0.25, 0.50);
+  v->decayDiffusion2Amount = clamp(value + 0.15f, 0.25f, 0.50f);
 }
 
 /* Set damping amount */
@@ -161,6 +166,21 @@ void DattorroVerb_setDamping(struct sDattorroVerb* v, float value) {
   v->dampingAmount = value;
 }
 
+void HOT_FUNC(DattorroVerb_setLite)(struct sDattorroVerb* v, bool lite) {
+  if (lite == v->lite) return;
+  // The diffusors stopped running when lite mode finished fading in, and
+  // still hold the audio of that moment. Clear them so it does not come
+  // back as a burst. A plain loop, memset may be in flash.
+  if (!lite && v->liteMix >= 1.0f) {
+    for (int i = 0; i < 4; i++) {
+      for (int k = 0; k <= v->inDiffusion[i].mask; k++) {
+        v->inDiffusion[i].buffer[k] = 0;
+      }
+    }
+  }
+  v->lite = lite;
+}
+
 /* Initialize DattorroVerb instance */
 void initialize(DattorroVerb* v) {
   memset(v, 0, sizeof(DattorroVerb));
@@ -246,7 +266,7 @@ void DattorroVerb_delete(DattorroVerb* v) {
 // After calling this function you can
 // get wet stereo reverb signal by calling
 // DattorroVerb_getLeft and DattorroVerb_getRight
-void DattorroVerb_process(DattorroVerb* v, float in) {
+void HOT_FUNC(DattorroVerb_process)(DattorroVerb* v, float in) {
   float x, x1;
 
   // Modulate decayDiffusion1A & decayDiffusion1B
@@ -266,15 +286,26 @@ void DattorroVerb_process(DattorroVerb* v, float in) {
   // Pre-filter
   x = LowPassFilter_process(&v->preFilter, v->preFilterAmount, x);
 
-  // Input diffusion
-  x = AllPassFilter_process(&v->inDiffusion[0], v->t, v->inputDiffusion1Amount,
-                            x);
-  x = AllPassFilter_process(&v->inDiffusion[1], v->t, v->inputDiffusion1Amount,
-                            x);
-  x = AllPassFilter_process(&v->inDiffusion[2], v->t, v->inputDiffusion2Amount,
-                            x);
-  x = AllPassFilter_process(&v->inDiffusion[3], v->t, v->inputDiffusion2Amount,
-                            x);
+  // Input diffusion, crossfaded with the dry path while lite changes
+  if (!v->lite || v->liteMix < 1.0f) {
+    float d;
+    d = AllPassFilter_process(&v->inDiffusion[0], v->t,
+                              v->inputDiffusion1Amount, x);
+    d = AllPassFilter_process(&v->inDiffusion[1], v->t,
+                              v->inputDiffusion1Amount, d);
+    d = AllPassFilter_process(&v->inDiffusion[2], v->t,
+                              v->inputDiffusion2Amount, d);
+    d = AllPassFilter_process(&v->inDiffusion[3], v->t,
+                              v->inputDiffusion2Amount, d);
+    if (v->lite) {
+      v->liteMix += 1.0f / LITE_FADE;
+      if (v->liteMix > 1.0f) v->liteMix = 1.0f;
+    } else if (v->liteMix > 0) {
+      v->liteMix -= 1.0f / LITE_FADE;
+      if (v->liteMix < 0) v->liteMix = 0;
+    }
+    x = d + (x - d) * v->liteMix;
+  }
 
   for (int i = 0; i < 2; i++) {
     // Add cross feedback
@@ -297,7 +328,7 @@ void DattorroVerb_process(DattorroVerb* v, float in) {
 }
 
 // Get left channel reverb
-float DattorroVerb_getLeft(DattorroVerb* v) {
+float HOT_FUNC(DattorroVerb_getLeft)(DattorroVerb* v) {
   float a;
   a = DelayBuffer_read(&v->preDampingDelay[1], TAP_OUT1, v->t);
   a += DelayBuffer_read(&v->preDampingDelay[1], TAP_OUT2, v->t);
@@ -310,7 +341,7 @@ float DattorroVerb_getLeft(DattorroVerb* v) {
 }
 
 // Get right channel reverb
-float DattorroVerb_getRight(DattorroVerb* v) {
+float HOT_FUNC(DattorroVerb_getRight)(DattorroVerb* v) {
   float a;
   a = DelayBuffer_read(&v->preDampingDelay[0], TAP_OUT1, v->t);
   a += DelayBuffer_read(&v->preDampingDelay[0], TAP_OUT2, v->t);
@@ -1,10 +1,11 @@
 #ifndef ADSR_LIB
 #define ADSR_LIB 1
 
-#include <math.h>
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "fastmath.h"
+
 enum envState { env_idle = 0, env_attack, env_decay, env_sustain, env_release };
 
 typedef struct ADSR {
@@ -67,7 +68,7 @@ float ADSR_process(ADSR *adsr) {
     float curve_shape = adsr->attack / adsr->shape;
     adsr->level =
         adsr->level_start + (adsr->max - adsr->level_start) *
-                                (1.0 - exp(-1.0 * (elapsed / curve_shape)));
+                                (1.0f - fast_expf(-(elapsed / curve_shape)));
     adsr->level_attack = adsr->level;
     adsr->level_release = adsr->level;
     if (elapsed >= adsr->attack) {
@@ -85,7 +86,7 @@ float ADSR_process(ADSR *adsr) {
       float curve_shape = adsr->decay / adsr->shape;
       adsr->level = (adsr->sustain * adsr->max) +
                     (adsr->level_attack - (adsr->sustain * adsr->max)) *
-                        exp(-1.0 * (elapsed / curve_shape));
+                        fast_expf(-(elapsed / curve_shape));
       adsr->level_release = adsr->level;
     }
   }
@@ -100,12 +101,12 @@ float ADSR_process(ADSR *adsr) {
 
   if (adsr->state == env_release) {
     uint32_t elapsed = adsr->sample_counter;
-    if (adsr->level < 0.001) {
+    if (adsr->level < 0.001f) {
       adsr->state = env_idle;
       adsr->level = 0;
     } else {
       float curve_shape = adsr->release / adsr->shape;
-      adsr->level = adsr->level_release * exp(-1.0 * (elapsed / curve_shape));
+      adsr->level = adsr->level_release * fast_expf(-(elapsed / curve_shape));
     }
   }
 
@@ -0,0 +1,76 @@
+#ifndef BUFFERING_LIB
+#define BUFFERING_LIB 1
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Output buffering policy
+//
+// The I2S output can run at any of a ladder of buffering levels, ordered by
+// latency: how many buffers are queued ahead of the one playing, and how
+// many frames each holds. The policy starts somewhere on the ladder, steps
+// one level up (more latency) whenever an underrun is reported, and one
+// level down after a window of frames without any. Every underrun also
+// doubles the window, up to a limit, so a level that has failed is tried
+// again less and less often and the output settles on the lowest latency
+// that keeps up.
+
+typedef struct BufferLevel {
+  uint8_t depth;    // buffers queued ahead of the playing one
+  uint16_t frames;  // frames per buffer
+} BufferLevel;
+
+static const BufferLevel buffer_levels[] = {
+    {2, 64},  {3, 64},  {2, 128}, {3, 128},
+    {2, 256}, {3, 256}, {4, 256}, {6, 256},
+};
+
+#define BUFFER_LEVELS (sizeof(buffer_levels) / sizeof(buffer_levels[0]))
+#define BUFFER_MAX_DEPTH 6
+#define BUFFER_MAX_FRAMES 256
+
+typedef struct BufferPolicy {
+  uint8_t level;       // index into buffer_levels
+  uint32_t underruns;  // underrun count seen at the last update
+  uint32_t clean;      // frames since the last underrun or level change
+  uint32_t window;     // clean frames needed before stepping down
+  uint32_t window_max;
+  uint16_t changes;  // level changes so far
+} BufferPolicy;
+
+static inline void BufferPolicy_init(BufferPolicy *p, uint8_t level,
+                                     uint32_t window, uint32_t window_max) {
+  p->level = level < BUFFER_LEVELS ? level : BUFFER_LEVELS - 1;
+  p->underruns = 0;
+  p->clean = 0;
+  p->window = window;
+  p->window_max = window_max;
+  p->changes = 0;
+}
+
+static inline const BufferLevel *BufferPolicy_level(const BufferPolicy *p) {
+  return &buffer_levels[p->level];
+}
+
+// Call after every buffer with the frames it held and the running underrun
+// count. Returns true if the level changed.
+static inline bool BufferPolicy_update(BufferPolicy *p, uint32_t frames,
+                                       uint32_t underruns) {
+  if (underruns != p->underruns) {
+    p->underruns = underruns;
+    p->clean = 0;
+    p->window = p->window * 2 < p->window_max ? p->window * 2 : p->window_max;
+    if (p->level + 1 >= BUFFER_LEVELS) return false;
+    p->level++;
+    p->changes++;
+    return true;
+  }
+  p->clean += frames;
+  if (p->clean < p->window || p->level == 0) return false;
+  p->clean = 0;
+  p->level--;
+  p->changes++;
+  return true;
+}
+
+#endif
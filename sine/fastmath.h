@@ -0,0 +1,126 @@
+#ifndef FASTMATH_LIB
+#define FASTMATH_LIB 1
+
+#include <stdint.h>
+#include <string.h>
+
+// Float-only transcendentals
+//
+// Polynomial approximations that never touch double, for code that runs on
+// a single-precision FPU (the RP2350's Cortex-M33) or just wants to stay in
+// float. Errors are the largest seen against double libm, over every float
+// in the range for the one-argument functions and over 10^8 random pairs
+// for powf, in float arithmetic:
+//
+//   fast_exp2f(x)    x in [-126, 127.999]  relative 1.1e-7
+//   fast_expf(x)     x in [-87.3, 88.7]    relative 1.3e-7
+//   fast_log2f(x)    x > 0, normal         absolute 1.9e-7 + |log2 x| * 6e-8
+//   fast_powf(x, y)  x > 0                 relative 1.1e-7 + |y| * 1.4e-7
+//                                            + |y log2 x| * 8.5e-8
+//   fast_tanhf(x)    all x                 absolute 1.8e-7
+//   fast_sinf(x)     |x| < 4096            absolute 1.9e-7
+//
+// The |y| term of powf is log2's absolute error, which near x = 1 is large
+// next to log2 x itself. Arguments outside the ranges are clamped (exp2f,
+// expf), give 0 (powf of x <= 0) or lose accuracy gradually (sinf). No NaN
+// or infinity handling.
+
+static inline float fastmath_from_bits(uint32_t bits) {
+  float f;
+  memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+static inline uint32_t fastmath_to_bits(float f) {
+  uint32_t bits;
+  memcpy(&bits, &f, sizeof(bits));
+  return bits;
+}
+
+// 2^(n + f) for f in [0, 1): 2^n goes straight into the exponent bits,
+// 2^f is a degree 6 polynomial
+static inline float fastmath_exp2_parts(int32_t n, float f) {
+  float p =
+      1.0f +
+      f * (0.693147044f +
+           f * (0.240229306f +
+                f * (0.0554852811f +
+                     f * (0.00967544996f +
+                          f * (0.00124678658f + f * 0.000216128355f)))));
+  return p * fastmath_from_bits((uint32_t)(n + 127) << 23);
+}
+
+static inline float fast_exp2f(float x) {
+  if (x < -126.0f) x = -126.0f;
+  if (x > 127.999f) x = 127.999f;
+  int32_t n = (int32_t)x;
+  if ((float)n > x) n--;
+  return fastmath_exp2_parts(n, x - (float)n);
+}
+
+// e^x: n = floor(x / ln 2) and r = x - n ln 2 with ln 2 in two parts
+// (Cody-Waite), so r stays exact and the error does not grow with |x| the
+// way rounding x * log2(e) would make it
+static inline float fast_expf(float x) {
+  if (x < -87.3f) x = -87.3f;
+  if (x > 88.7f) x = 88.7f;
+  float k = x * 1.44269504f;
+  int32_t n = (int32_t)k;
+  if ((float)n > k) n--;
+  float r = x - (float)n * 0.693359375f;
+  r -= (float)n * -2.12194440e-4f;
+  return fastmath_exp2_parts(n, r * 1.44269504f);
+}
+
+// log2(x): the exponent bits, plus a degree 8 polynomial in m - 1 for the
+// mantissa m in [1, 2)
+static inline float fast_log2f(float x) {
+  uint32_t bits = fastmath_to_bits(x);
+  float e = (float)((int32_t)(bits >> 23) - 127);
+  float t = fastmath_from_bits((bits & 0x007FFFFF) | 0x3F800000) - 1.0f;
+  float p =
+      t * (1.44268988f +
+           t * (-0.721165765f +
+                t * (0.478683356f +
+                     t * (-0.347299691f +
+                          t * (0.241861715f +
+                               t * (-0.137517626f +
+                                    t * (0.0520566412f +
+                                         t * -0.00930855543f)))))));
+  return e + p;
+}
+
+static inline float fast_powf(float x, float y) {
+  if (x <= 0) return 0;
+  return fast_exp2f(y * fast_log2f(x));
+}
+
+// tanh(x) = 1 - 2 / (e^2x + 1), with the Taylor series near 0 where that
+// form cancels
+static inline float fast_tanhf(float x) {
+  if (x > 9.0f) return 1.0f;
+  if (x < -9.0f) return -1.0f;
+  float x2 = x * x;
+  if (x2 < 0.0025f) {
+    return x * (1.0f + x2 * (-0.333333333f + x2 * 0.133333333f));
+  }
+  return 1.0f - 2.0f / (fast_expf(2.0f * x) + 1.0f);
+}
+
+// sin(x): reduce to r in [-pi/2, pi/2] around the nearest multiple k of
+// pi, in two steps so r keeps its low bits, then an odd degree 9
+// polynomial, negated for odd k
+static inline float fast_sinf(float x) {
+  float k = x * 0.318309886f;
+  int32_t n = (int32_t)(k < 0 ? k - 0.5f : k + 0.5f);
+  float r = x - (float)n * 3.140625f;
+  r -= (float)n * 9.67653590e-4f;
+  float r2 = r * r;
+  float p = r * (0.999999977f +
+                 r2 * (-0.166666476f +
+                       r2 * (0.00833289984f +
+                             r2 * (-0.000198008982f + r2 * 2.59048875e-06f))));
+  return (n & 1) ? -p : p;
+}
+
+#endif
@@ -7,14 +7,76 @@
 #include <math.h>
 #include <stdio.h>
 
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
 #include "pico/audio_i2s.h"
+#include "pico/multicore.h"
 #include "pico/stdlib.h"
 
+#include "buffering.h"
+
 #define SINE_WAVE_TABLE_LEN 2048
-#define SAMPLES_PER_BUFFER 256
+#define SAMPLES_PER_BUFFER BUFFER_MAX_FRAMES
 
 static int16_t sine_wave_table[SINE_WAVE_TABLE_LEN];
 
+#define AUDIO_DMA_CHANNEL 6
+
+static struct audio_buffer_pool *producer_pool;
+
+// Buffers queued by the render loop, buffers the output has taken, and
+// times the output found nothing queued and played silence instead. given
+// is written by the render loop (in counted_give), the others by the DMA
+// interrupt, which runs on the same core.
+static volatile uint32_t given;
+static volatile uint32_t taken;
+static volatile uint32_t underruns;
+
+// Runs in the DMA interrupt just before the I2S driver's own handler, at
+// the end of every transfer, when the driver is about to take the next
+// buffer: if none is queued it will play silence, which is an underrun.
+// Silence before the first buffer is not counted.
+static void __isr __not_in_flash_func(audio_dma_irq)() {
+  if (!(dma_hw->ints0 & (1u << AUDIO_DMA_CHANNEL)) || !given) return;
+  if (producer_pool->prepared_list) {
+    taken++;
+  } else {
+    underruns++;
+  }
+}
+
+// The I2S driver plays the render loop's buffers directly instead of
+// copying them into its own, so a buffer can hold any number of frames up
+// to SAMPLES_PER_BUFFER and the only latency is what the loop queues.
+static audio_buffer_t *pass_thru_take(audio_connection_t *connection,
+                                      bool block) {
+  return get_full_audio_buffer(connection->producer_pool, block);
+}
+
+static void pass_thru_give(audio_connection_t *connection,
+                           audio_buffer_t *buffer) {
+  queue_free_audio_buffer(connection->producer_pool, buffer);
+}
+
+// give_audio_buffer lands here. The buffer is queued and counted with the
+// DMA interrupt masked, so audio_dma_irq never sees it queued but not yet
+// in given, which would leave given - taken one too high for good.
+static void counted_give(audio_connection_t *connection,
+                         audio_buffer_t *buffer) {
+  uint32_t save = save_and_disable_interrupts();
+  producer_pool_give_buffer_default(connection, buffer);
+  given++;
+  restore_interrupts(save);
+}
+
+static audio_connection_t pass_thru_connection = {
+    .consumer_pool_take = pass_thru_take,
+    .consumer_pool_give = pass_thru_give,
+    .producer_pool_take = producer_pool_take_buffer_default,
+    .producer_pool_give = counted_give,
+};
+
 struct audio_buffer_pool *init_audio() {
   static audio_format_t audio_format = {
       .format = AUDIO_BUFFER_FORMAT_PCM_S16,
@@ -25,24 +87,27 @@ struct audio_buffer_pool *init_audio() {
   static struct audio_buffer_format producer_format = {.format = &audio_format,
                                                        .sample_stride = 4};
 
-  struct audio_buffer_pool *producer_pool =
-      audio_new_producer_pool(&producer_format, 3,
-                              SAMPLES_PER_BUFFER);  // todo correct size
+  // the deepest level queues BUFFER_MAX_DEPTH while one plays and one is
+  // being rendered
+  producer_pool = audio_new_producer_pool(
+      &producer_format, BUFFER_MAX_DEPTH + 2, SAMPLES_PER_BUFFER);
   bool __unused ok;
   const struct audio_format *output_format;
   struct audio_i2s_config config = {
       .data_pin = PICO_AUDIO_I2S_DATA_PIN,
       .clock_pin_base = PICO_AUDIO_I2S_CLOCK_PIN_BASE,
-      .dma_channel = 6,
+      .dma_channel = AUDIO_DMA_CHANNEL,
       .pio_sm = 1,
   };
 
+  irq_add_shared_handler(DMA_IRQ_0, audio_dma_irq,
+                         PICO_SHARED_IRQ_HANDLER_HIGHEST_ORDER_PRIORITY);
   output_format = audio_i2s_setup(&audio_format, &config);
   if (!output_format) {
     panic("PicoAudio: Unable to open audio device.\n");
   }
 
-  ok = audio_i2s_connect(producer_pool);
+  ok = audio_i2s_connect_thru(producer_pool, &pass_thru_connection);
   assert(ok);
   audio_i2s_set_enabled(true);
 
@@ -50,6 +115,8 @@ struct audio_buffer_pool *init_audio() {
 }
 
 #include "adsr.h"
+#include "blockstats.h"
+#include "telemetry.h"
 #include "verb.h"
 
 const int block_size = 8192;
@@ -88,12 +155,16 @@ typedef struct LFSaws {
 } LFSaws;
 
 float detuneCurve(float x) {
-  return (10028.7312891634 * pow(x, 11)) - (50818.8652045924 * pow(x, 10)) +
-         (111363.4808729368 * pow(x, 9)) - (138150.6761080548 * pow(x, 8)) +
-         (106649.6679158292 * pow(x, 7)) - (53046.9642751875 * pow(x, 6)) +
-         (17019.9518580080 * pow(x, 5)) - (3425.0836591318 * pow(x, 4)) +
-         (404.2703938388 * pow(x, 3)) - (24.1878824391 * pow(x, 2)) +
-         (0.6717417634 * x) + 0.0030115596;
+  // the fitted polynomial, expanded around x = 0.5 so that evaluating it in
+  // float does not cancel: within 1.2e-6 of the original on [0, 1]
+  static const float coefficients[12] = {
+      0.0979551523f, 0.261076015f, 1.20727185f,  4.75063955f,
+      -18.6035476f,  -81.164784f,  280.892017f,  877.89611f,
+      -1884.66289f,  -4835.78992f, 4339.15689f,  10028.7313f};
+  float u = x - 0.5f;
+  float y = 0;
+  for (int k = 11; k >= 0; k--) y = y * u + coefficients[k];
+  return y;
 }
 
 float detuneAmounts[7] = {-0.11002313, -0.06288439, -0.01952356, 0,
@@ -104,10 +175,10 @@ void LFSaws_init(LFSaws *saws, float freq, float sample_rate) {
   // generate random number between 0.4 and 0.6
   float detuneFactor = freq * detuneCurve(0.6);
   // print to stderr
-  fprintf(stderr, "detuneFactor: %f\n", detuneFactor);
+  fprintf(stderr, "detuneFactor: %f\n", (double)detuneFactor);
   for (int i = 0; i < 7; i++) {
     LFSaw_init(&saws->saws[i], freq + detuneFactor * detuneAmounts[i],
-               sample_rate, amplitudeAmounts[i] / 4.0);
+               sample_rate, amplitudeAmounts[i] / 4.0f);
   }
 }
 
@@ -128,7 +199,7 @@ void WhiteNoise_init(WhiteNoise *noise, float amplitude) {
 }
 
 float WhiteNoise_next_sample(WhiteNoise *noise) {
-  return ((float)rand() / RAND_MAX - 0.5) * noise->amplitude;
+  return ((float)rand() / RAND_MAX - 0.5f) * noise->amplitude;
 }
 
 typedef struct OnePole {
@@ -137,7 +208,7 @@ typedef struct OnePole {
 
 // out(i) = ((1 - abs(coef)) * in(i)) + (coef * out(i-1)).
 float __not_in_flash_func(OnePole_next)(OnePole *self, float in, float coef) {
-  float out = ((1 - fabs(coef)) * in) + (coef * self->prev_out);
+  float out = ((1 - fabsf(coef)) * in) + (coef * self->prev_out);
   self->prev_out = out;
   return out;
 }
@@ -174,6 +245,73 @@ void Voice_set_release(Voice *voice, float release) {
   ADSR_set_release(&voice->adsr, release);
 }
 
+#define NUM_VOICES 3
+static Voice voice[NUM_VOICES];
+
+// render time of every buffer in us, scaled to SAMPLES_PER_BUFFER frames,
+// against the time that many frames play for
+static BlockStats stats;
+// one record per buffer from the audio core, printed by core0
+static Telemetry telemetry;
+
+// commands from core0 to the audio core through the multicore FIFO
+enum { command_gate_off = 0, command_gate_on };
+
+// Audio core: owns the voices and the I2S output, and never prints, so a
+// stalled USB serial port cannot hold up a buffer. Key presses arrive as
+// FIFO commands and are applied between buffers. The buffering level
+// decides how far ahead of the output it renders and in what block size.
+void core1_main() {
+  struct audio_buffer_pool *ap = init_audio();
+  BufferPolicy policy;
+  // start in the middle, try a level lower after 2 s without underruns,
+  // backing off to a minute
+  BufferPolicy_init(&policy, BUFFER_LEVELS / 2, 2 * 44100, 60 * 44100);
+  uint32_t block = 0, reported = 0;
+  while (true) {
+    while (multicore_fifo_rvalid()) {
+      bool gate = multicore_fifo_pop_blocking() == command_gate_on;
+      for (int i = 0; i < NUM_VOICES; i++) Voice_gate(&voice[i], gate);
+    }
+    const BufferLevel *level = BufferPolicy_level(&policy);
+    while (given - taken >= level->depth) tight_loop_contents();
+    struct audio_buffer *buffer = take_audio_buffer(ap, true);
+    int16_t *samples = (int16_t *)buffer->buffer->bytes;
+    uint32_t block_start = time_us_32();
+    TelemetryRecord r = {.block = block++,
+                         .frames = level->frames,
+                         .depth = level->depth,
+                         .min = 1,
+                         .max = -1};
+    for (uint i = 0; i < level->frames * 2; i += 2) {
+      float sample = 0;
+      for (int j = 0; j < NUM_VOICES; j++)
+        sample += Voice_next_sample(&voice[j]) / NUM_VOICES;
+      if (sample < r.min) r.min = sample;
+      if (sample > r.max) r.max = sample;
+      // DattorroVerb_process(verb, sample);
+      // float sampleL = DattorroVerb_getLeft(verb);
+      // float sampleR = DattorroVerb_getRight(verb);
+      samples[i] = (int16_t)(sample * 32767);
+      samples[i + 1] = (int16_t)(sample * 32767);
+    }
+    r.ticks = time_us_32() - block_start;
+    r.voice_ticks = r.ticks;
+    for (int j = 0; j < NUM_VOICES; j++) {
+      if (voice[j].adsr.state != env_idle) r.voices++;
+    }
+    BlockStats_record(&stats, r.ticks * SAMPLES_PER_BUFFER / r.frames);
+    buffer->sample_count = level->frames;
+    give_audio_buffer(ap, buffer);  // counts it in given
+
+    uint32_t count = underruns;
+    r.underruns = count - reported;
+    reported = count;
+    BufferPolicy_update(&policy, r.frames, count);
+    Telemetry_push(&telemetry, &r);
+  }
+}
+
 int main() {
   stdio_init_all();
 
@@ -199,8 +337,6 @@ int main() {
   DattorroVerb_setDecay(verb, 0.9);
   DattorroVerb_setDamping(verb, 0.3);
 
-#define NUM_VOICES 3
-  Voice voice[NUM_VOICES];
   // overtone series
   float freqs[7] = {111, 219, 441, 55, 1760, 3520, 7040};
   float amps[7] = {0.75, 0.5, 0.25, 0.25, 0.125, 0.0625, 0.03125};
@@ -209,50 +345,48 @@ int main() {
     Voice_gate(&voice[i], true);
     Voice_set_release(&voice[i], 0.1);
   }
-  struct audio_buffer_pool *ap = init_audio();
+  BlockStats_init(&stats, SAMPLES_PER_BUFFER * 1000000ull / 44100);
+  Telemetry_init(&telemetry);
+  multicore_launch_core1(core1_main);
 
-  uint64_t end_time = 0;
-  uint64_t start_time = 0;
+  // core0 only handles keys and prints what the audio core reports
+  TelemetryRecord r, second = {.min = 1, .max = -1};
+  uint32_t last_depth = 0, last_frames = 0;
   while (true) {
     int c = getchar_timeout_us(0);
     if (c >= 0) {
-      if (c == '-' && vol) {
-        for (int i = 0; i < NUM_VOICES; i++) Voice_gate(&voice[i], false);
-      }
-      if (c == '=' || c == '+') {
-        // start all voices
-        for (int i = 0; i < NUM_VOICES; i++) Voice_gate(&voice[i], true);
-      }
-
-      float percent_audio_block =
-          (float)(start_time - end_time) / (float)SAMPLES_PER_BUFFER;
-      printf("vol = %d, step = %d %2.1f     \r", vol, step >> 16,
-             percent_audio_block);
+      if (c == '-') multicore_fifo_push_blocking(command_gate_off);
+      if (c == '=' || c == '+') multicore_fifo_push_blocking(command_gate_on);
+
+      BlockStatsSnapshot snapshot;
+      BlockStats_snapshot(&stats, &snapshot, true);
+      printf("vol = %d, step = %d, block us: mean %lu p99 < %lu max %lu, "
+             "%lu/%lu over %lu\n",
+             vol, step >> 16, BlockStats_mean(&snapshot),
+             BlockStats_percentile(&snapshot, 0.99f), snapshot.max,
+             snapshot.misses, snapshot.blocks, snapshot.deadline);
     }
-    struct audio_buffer *buffer = take_audio_buffer(ap, true);
-    int16_t *samples = (int16_t *)buffer->buffer->bytes;
-    end_time = time_us_64();
-    for (uint i = 0; i < buffer->max_sample_count * 2; i += 2) {
-      float sample = 0;
-      for (int j = 0; j < NUM_VOICES; j++)
-        sample += Voice_next_sample(&voice[j]) / NUM_VOICES;
-      if (i == 44100 * 5) {
-        for (int j = 0; j < NUM_VOICES; j++) Voice_gate(&voice[j], false);
-      }
-      // DattorroVerb_process(verb, sample);
-      // float sampleL = DattorroVerb_getLeft(verb);
-      // float sampleR = DattorroVerb_getRight(verb);
-      samples[i] = (int16_t)(sample * 32767);
-      samples[i + 1] = (int16_t)(sample * 32767);
-      // samples[i] = sampleL(vol * sine_wave_table[pos >> 16u]) >> 8u;
-      // samples[i + 1] = (vol * sine_wave_table[pos >> 16u]) >> 8u;
-      // pos += step;
-      // if (pos >= pos_max) pos -= pos_max;
+    if (!Telemetry_pop(&telemetry, &r)) continue;
+    if (r.depth != last_depth || r.frames != last_frames) {
+      printf("buffering: %u x %lu frames, %.1f ms ahead\n", r.depth, r.frames,
+             r.depth * r.frames * 1000.0 / 44100);
+      last_depth = r.depth;
+      last_frames = r.frames;
+    }
+    second.frames += r.frames;
+    second.underruns += r.underruns;
+    if (r.ticks > second.ticks) second.ticks = r.ticks;
+    if (r.voices > second.voices) second.voices = r.voices;
+    if (r.min < second.min) second.min = r.min;
+    if (r.max > second.max) second.max = r.max;
+    if (second.frames >= 44100) {
+      printf("block %lu: voices %u, slowest block %lu us, level %.3f..%.3f, "
+             "underruns %u, dropped %lu\n",
+             r.block, second.voices, second.ticks, (double)second.min,
+             (double)second.max, second.underruns,
+             Telemetry_dropped(&telemetry));
+      second = (TelemetryRecord){.min = 1, .max = -1};
     }
-    start_time = time_us_64();
-    buffer->sample_count = buffer->max_sample_count;
-    give_audio_buffer(ap, buffer);
   }
-  puts("\n");
   return 0;
 }
@@ -153,7 +153,7 @@ void DattorroVerb_setDecayDiffusion(struct sDattorroVerb* v, float value) {
 /* Set decay amount and calculate related decay diffusion 2 amount */
 void DattorroVerb_setDecay(DattorroVerb* v, float value) {
   v->decayAmount = value;
-  v->decayDiffusion2Amount = clamp(value + 0.15, 0.25, 0.50);
+  v->decayDiffusion2Amount = clamp(value + 0.15f, 0.25f, 0.50f);
 }
 
 /* Set damping amount */
@@ -161,6 +161,10 @@ void DattorroVerb_setDamping(struct sDattorroVerb* v, float value) {
   v->dampingAmount = value;
 }
 
+void DattorroVerb_setLite(struct sDattorroVerb* v, bool lite) {
+  v->lite = lite;
+}
+
 /* Initialize DattorroVerb instance */
 void initialize(DattorroVerb* v) {
   memset(v, 0, sizeof(DattorroVerb));
@@ -267,14 +271,16 @@ void DattorroVerb_process(DattorroVerb* v, float in) {
   x = LowPassFilter_process(&v->preFilter, v->preFilterAmount, x);
 
   // Input diffusion
-  x = AllPassFilter_process(&v->inDiffusion[0], v->t, v->inputDiffusion1Amount,
-                            x);
-  x = AllPassFilter_process(&v->inDiffusion[1], v->t, v->inputDiffusion1Amount,
-                            x);
-  x = AllPassFilter_process(&v->inDiffusion[2], v->t, v->inputDiffusion2Amount,
-                            x);
-  x = AllPassFilter_process(&v->inDiffusion[3], v->t, v->inputDiffusion2Amount,
-                            x);
+  if (!v->lite) {
+    x = AllPassFilter_process(&v->inDiffusion[0], v->t,
+                              v->inputDiffusion1Amount, x);
+    x = AllPassFilter_process(&v->inDiffusion[1], v->t,
+                              v->inputDiffusion1Amount, x);
+    x = AllPassFilter_process(&v->inDiffusion[2], v->t,
+                              v->inputDiffusion2Amount, x);
+    x = AllPassFilter_process(&v->inDiffusion[3], v->t,
+                              v->inputDiffusion2Amount, x);
+  }
 
   for (int i = 0; i < 2; i++) {
     // Add cross feedback
@@ -1,3 +1,5 @@
+#include <stdbool.h>
+
 struct sDattorroVerb;
 
 /* Get pointer to initialized DattorroVerb struct */
@@ -15,6 +17,10 @@ void DattorroVerb_setDecayDiffusion(struct sDattorroVerb* v, float value);
 void DattorroVerb_setDecay(struct sDattorroVerb* v, float value);
 void DattorroVerb_setDamping(struct sDattorroVerb* v, float value);
 
+/* Cheaper mode for when the CPU is short: skip the four input diffusors,
+   the tank still diffuses but attacks smear less */
+void DattorroVerb_setLite(struct sDattorroVerb* v, bool lite);
+
 /* Send mono input into reverbation tank */
 void DattorroVerb_process(struct sDattorroVerb* v, float in);
 
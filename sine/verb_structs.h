@@ -1,3 +1,4 @@
+#include <stdbool.h>
 #include <stdint.h>
 
 enum { TAP_MAIN = 0, TAP_OUT1, TAP_OUT2, TAP_OUT3, MAX_TAPS };
@@ -45,6 +46,9 @@ typedef struct sDattorroVerb {
   float decayAmount;
   float decayDiffusion2Amount;  // Automatically set in DattorroVerb_setDecay
 
+  // Skip the input diffusors (see DattorroVerb_setLite)
+  bool lite;
+
   // Cycle count for syncing delay lines
   uint16_t t;
 } DattorroVerb;
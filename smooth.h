@@ -0,0 +1,54 @@
+#ifndef SMOOTH_LIB
+#define SMOOTH_LIB 1
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Block-rate parameter smoothing
+//
+// A new target set with SmoothedParam_set is reached with one linear ramp
+// over the next block: SmoothedParam_begin_block works out the per-sample
+// step once, and SmoothedParam_next adds it, landing exactly on the target
+// at the last sample. Parameters that are not moving cost one comparison
+// per block, so callers can check the return value of begin_block and run
+// a constant-parameter loop instead.
+
+typedef struct SmoothedParam {
+  float value;         // current value
+  float target;        // value at the end of the ramp
+  float step;          // per-sample increment of the current ramp
+  uint16_t remaining;  // samples left in the current ramp
+} SmoothedParam;
+
+static inline void SmoothedParam_init(SmoothedParam *p, float value) {
+  p->value = value;
+  p->target = value;
+  p->step = 0;
+  p->remaining = 0;
+}
+
+// Set a new target, reached over the next block
+static inline void SmoothedParam_set(SmoothedParam *p, float target) {
+  p->target = target;
+}
+
+// Start a block of n samples. Returns true if the value moves in this block.
+static inline bool SmoothedParam_begin_block(SmoothedParam *p, uint16_t n) {
+  if (p->value == p->target || n == 0) {
+    p->remaining = 0;
+    return false;
+  }
+  p->step = (p->target - p->value) / n;
+  p->remaining = n;
+  return true;
+}
+
+// Value for the next sample
+static inline float SmoothedParam_next(SmoothedParam *p) {
+  if (p->remaining) {
+    p->value = --p->remaining ? p->value + p->step : p->target;
+  }
+  return p->value;
+}
+
+#endif
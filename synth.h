@@ -0,0 +1,275 @@
+#ifndef SYNTH_LIB
+#define SYNTH_LIB 1
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "convverb.h"
+#include "events.h"
+#include "fastmath.h"
+#include "reverb.h"
+#include "voice.h"
+
+// Block renderer
+//
+// Owns a pool of voices, the reverb and the event queue. Synth_render splits
+// each block at the offsets of the queued events: every event due at the
+// current position is applied, then each active voice renders its whole run
+// up to the next event in one loop. Idle voices are skipped.
+
+#define SYNTH_MAX_BLOCK 1024
+
+// note allocation state of a voice, see Synth_note_on
+typedef struct SynthSlot {
+  int16_t note;    // channel << 7 | note, -1 before the first note
+  bool held;       // note on without its note off yet
+  uint64_t since;  // sample of the last note on or note off
+} SynthSlot;
+
+typedef struct Synth {
+  Voice *voices;
+  SynthSlot *slots;
+  uint16_t num_voices;
+  float sample_rate;
+  float gain;              // mix level of each voice
+  Reverb *verb;            // algorithmic reverb
+  struct sConvVerb *conv;  // replaces verb when set, owned by the caller
+  bool bypass;             // skip the reverb, both outputs get the dry mix
+  uint64_t time;           // sample time of the next rendered sample
+  EventQueue events;
+  float mono[SYNTH_MAX_BLOCK];  // dry voice mix
+} Synth;
+
+static inline Synth *Synth_create(uint16_t num_voices, float sample_rate) {
+  Synth *s = malloc(sizeof(Synth));
+  if (!s) return NULL;
+  s->voices = malloc(num_voices * sizeof(Voice));
+  s->slots = malloc(num_voices * sizeof(SynthSlot));
+  s->verb = Reverb_create();
+  if (!s->voices || !s->slots || !s->verb) {
+    free(s->voices);
+    free(s->slots);
+    if (s->verb) Reverb_delete(s->verb);
+    free(s);
+    return NULL;
+  }
+  for (int i = 0; i < num_voices; i++) {
+    Voice_init(&s->voices[i], 440, 0, sample_rate);
+    s->slots[i] = (SynthSlot){.note = -1, .held = false, .since = 0};
+  }
+  s->num_voices = num_voices;
+  s->sample_rate = sample_rate;
+  s->gain = 1.0f / num_voices;
+  s->conv = NULL;
+  s->bypass = false;
+  s->time = 0;
+  EventQueue_init(&s->events);
+  return s;
+}
+
+static inline void Synth_delete(Synth *s) {
+  Reverb_delete(s->verb);
+  free(s->voices);
+  free(s->slots);
+  free(s);
+}
+
+// The "giant reverb" patch
+static inline void Synth_set_giant_reverb(Synth *s) {
+  Reverb_setPreDelay(s->verb, 0.2);
+  Reverb_setPreFilter(s->verb, 0.9);
+  Reverb_setInputDiffusion1(s->verb, 0.85);
+  Reverb_setInputDiffusion2(s->verb, 0.75);
+  Reverb_setDecayDiffusion(s->verb, 0.5);
+  Reverb_setDecay(s->verb, 0.9);
+  Reverb_setDamping(s->verb, 0.4);
+}
+
+// Return to silence at time 0 for another render, without allocating.
+// Voices are reseeded from seed so the render is repeatable, and the reverb
+// starts on the settings made before the reset.
+static inline void Synth_reset(Synth *s, uint32_t seed) {
+  for (int i = 0; i < s->num_voices; i++) {
+    Voice_init(&s->voices[i], 440, 0, s->sample_rate);
+    Voice_seed(&s->voices[i], seed + i);
+    s->slots[i] = (SynthSlot){.note = -1, .held = false, .since = 0};
+  }
+  Reverb_clear(s->verb);
+  EventQueue_init(&s->events);
+  s->time = 0;
+}
+
+// Queue an event, returns false if the queue is full. Events timed before
+// the next rendered sample apply at the start of the next block.
+static inline bool Synth_post(Synth *s, const Event *e) {
+  return EventQueue_push(&s->events, e);
+}
+
+// Free entries in the event queue
+static inline uint32_t Synth_room(const Synth *s) {
+  return EVENT_QUEUE_SIZE - s->events.count;
+}
+
+// Play a note at sample time. A voice already playing the same note is
+// retriggered; otherwise the voice released the longest ago is used, and
+// only when every voice is held is the oldest note stolen. Returns false,
+// changing nothing, if the event queue has no room for the note.
+static inline bool Synth_note_on(Synth *s, uint64_t time, uint8_t channel,
+                                 uint8_t note, float amp) {
+  if (Synth_room(s) < 2) return false;
+  int16_t key = (channel << 7) | note;
+  uint16_t best = 0;
+  for (uint16_t i = 0; i < s->num_voices; i++) {
+    SynthSlot *slot = &s->slots[i], *b = &s->slots[best];
+    if (slot->held && slot->note == key) {
+      best = i;
+      break;
+    }
+    if (slot->held != b->held ? !slot->held : slot->since < b->since) {
+      best = i;
+    }
+  }
+  SynthSlot *slot = &s->slots[best];
+  if (slot->held) {
+    // close the old note so the envelope restarts from its current level
+    Event off = {.time = time, .type = event_note_off, .voice = best};
+    Synth_post(s, &off);
+  }
+  Event on = {.time = time,
+              .type = event_note_on,
+              .voice = best,
+              .value = 440 * fast_exp2f((note - 69) / 12.0f),
+              .amp = amp};
+  Synth_post(s, &on);
+  *slot = (SynthSlot){.note = key, .held = true, .since = time};
+  return true;
+}
+
+// Release a note started with Synth_note_on, ignored if it was stolen.
+// Returns false, changing nothing, if the event queue is full.
+static inline bool Synth_note_off(Synth *s, uint64_t time, uint8_t channel,
+                                  uint8_t note) {
+  if (Synth_room(s) < 1) return false;
+  int16_t key = (channel << 7) | note;
+  for (uint16_t i = 0; i < s->num_voices; i++) {
+    SynthSlot *slot = &s->slots[i];
+    if (slot->held && slot->note == key) {
+      Event off = {.time = time, .type = event_note_off, .voice = i};
+      Synth_post(s, &off);
+      slot->held = false;
+      slot->since = time;
+      return true;
+    }
+  }
+  return true;
+}
+
+// set a parameter mid-block, continuous voice settings ramp over the
+// remaining n samples of the block
+static inline void Synth_set_param(Synth *s, Voice *voice, uint8_t param,
+                                   float value, uint16_t n) {
+  switch (param) {
+    case param_freq:
+      LFSaws_set_freq(&voice->saws, value);
+      break;
+    case param_amp:
+      SmoothedParam_set(&voice->amp, value);
+      SmoothedParam_begin_block(&voice->amp, n);
+      break;
+    case param_filter:
+      SmoothedParam_set(&voice->filter, value);
+      SmoothedParam_begin_block(&voice->filter, n);
+      break;
+    case param_sustain:
+      ADSR_set_sustain(&voice->adsr, value);
+      ADSR_begin_block(&voice->adsr, n);
+      break;
+    case param_release:
+      ADSR_set_release(&voice->adsr, value);
+      break;
+    case param_detune:
+      LFSaws_set_detune(&voice->saws, value);
+      break;
+    // the reverb picks these up at its next block
+    case param_reverb_decay:
+      Reverb_setDecay(s->verb, value);
+      break;
+    case param_reverb_damping:
+      Reverb_setDamping(s->verb, value);
+      break;
+  }
+}
+
+static inline void Synth_apply(Synth *s, const Event *e, uint16_t n) {
+  // reverb parameters do not address a voice
+  if (e->type == event_param && e->param >= param_reverb_decay) {
+    Synth_set_param(s, NULL, e->param, e->value, n);
+    return;
+  }
+  if (e->voice >= s->num_voices) return;
+  Voice *voice = &s->voices[e->voice];
+  switch (e->type) {
+    case event_note_on:
+      Voice_note_on(voice, e->value, e->amp);
+      break;
+    case event_note_off:
+      Voice_gate(voice, false);
+      break;
+    case event_gate:
+      Voice_gate(voice, e->value != 0);
+      break;
+    case event_param:
+      Synth_set_param(s, voice, e->param, e->value, n);
+      break;
+  }
+}
+
+// Render n <= SYNTH_MAX_BLOCK stereo samples
+static inline void Synth_render(Synth *s, float *outL, float *outR,
+                                uint16_t n) {
+  for (int j = 0; j < s->num_voices; j++) Voice_begin_block(&s->voices[j], n);
+  memset(s->mono, 0, n * sizeof(float));
+
+  uint16_t pos = 0;
+  while (pos < n) {
+    // apply everything due now, then find where the next event splits the run
+    uint16_t end = n;
+    const Event *e;
+    while ((e = EventQueue_peek(&s->events))) {
+      if (e->time > s->time + pos) {
+        if (e->time < s->time + n) end = e->time - s->time;
+        break;
+      }
+      Synth_apply(s, e, n - pos);
+      EventQueue_pop(&s->events);
+    }
+    for (int j = 0; j < s->num_voices; j++) {
+      if (Voice_is_idle(&s->voices[j])) continue;
+      Voice_render(&s->voices[j], s->mono + pos, end - pos, s->gain);
+    }
+    pos = end;
+  }
+
+  if (s->bypass) {
+    memcpy(outL, s->mono, n * sizeof(float));
+    memcpy(outR, s->mono, n * sizeof(float));
+  } else if (s->conv) {
+    ConvVerb_process_block(s->conv, s->mono, outL, outR, n);
+  } else {
+    Reverb_process_block(s->verb, s->mono, outL, outR, n);
+  }
+  s->time += n;
+}
+
+// Number of voices currently sounding
+static inline uint16_t Synth_sounding(Synth *s) {
+  uint16_t count = 0;
+  for (int j = 0; j < s->num_voices; j++) {
+    if (!Voice_is_idle(&s->voices[j])) count++;
+  }
+  return count;
+}
+
+#endif
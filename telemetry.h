@@ -0,0 +1,87 @@
+#ifndef TELEMETRY_LIB
+#define TELEMETRY_LIB 1
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Lock-free telemetry ring from the audio thread to a logging thread
+//
+// The audio thread fills in one fixed-size record per block and pushes it,
+// which is a struct copy and one release store; it never formats, prints or
+// waits. A second core (core0 on the Pico) or a host thread pops the
+// records and does the slow part. There is exactly one producer and one
+// consumer, each owning one index, so no locks or compare-and-swap are
+// needed. When the consumer falls behind, new records are dropped and
+// counted rather than overwriting ones it may be reading.
+
+#define TELEMETRY_SIZE 256  // records, a power of two
+
+typedef struct TelemetryRecord {
+  uint32_t block;        // block number
+  uint32_t frames;       // frames rendered in the block
+  uint32_t ticks;        // time spent rendering the whole block
+  uint32_t voice_ticks;  // of which rendering voices, 0 if not measured
+  uint16_t voices;       // voices sounding
+  uint16_t underruns;    // output underruns noticed during the block
+  uint16_t depth;        // output buffers queued ahead, 0 if fixed
+  uint16_t shed;         // load governor level, 0 if nothing is shed
+  float min;             // lowest output sample
+  float max;             // highest output sample
+} TelemetryRecord;
+
+typedef struct Telemetry {
+  _Atomic uint32_t head;     // next record to write, owned by the producer
+  _Atomic uint32_t tail;     // next record to read, owned by the consumer
+  _Atomic uint32_t dropped;  // records lost to a full ring
+  TelemetryRecord records[TELEMETRY_SIZE];
+} Telemetry;
+
+static inline void Telemetry_init(Telemetry *t) {
+  atomic_init(&t->head, 0);
+  atomic_init(&t->tail, 0);
+  atomic_init(&t->dropped, 0);
+}
+
+// Audio thread: queue a record, returns false and counts it as dropped if
+// the ring is full
+static inline bool Telemetry_push(Telemetry *t, const TelemetryRecord *r) {
+  uint32_t head = atomic_load_explicit(&t->head, memory_order_relaxed);
+  uint32_t tail = atomic_load_explicit(&t->tail, memory_order_acquire);
+  if (head - tail == TELEMETRY_SIZE) {
+    atomic_store_explicit(
+        &t->dropped,
+        atomic_load_explicit(&t->dropped, memory_order_relaxed) + 1,
+        memory_order_relaxed);
+    return false;
+  }
+  t->records[head & (TELEMETRY_SIZE - 1)] = *r;
+  atomic_store_explicit(&t->head, head + 1, memory_order_release);
+  return true;
+}
+
+// Logging thread: take the oldest record, returns false if there is none
+static inline bool Telemetry_pop(Telemetry *t, TelemetryRecord *r) {
+  uint32_t tail = atomic_load_explicit(&t->tail, memory_order_relaxed);
+  uint32_t head = atomic_load_explicit(&t->head, memory_order_acquire);
+  if (head == tail) return false;
+  *r = t->records[tail & (TELEMETRY_SIZE - 1)];
+  atomic_store_explicit(&t->tail, tail + 1, memory_order_release);
+  return true;
+}
+
+// Logging thread: records dropped so far
+static inline uint32_t Telemetry_dropped(Telemetry *t) {
+  return atomic_load_explicit(&t->dropped, memory_order_relaxed);
+}
+
+// Audio thread: widen the record's level range by a block of samples
+static inline void Telemetry_levels(TelemetryRecord *r, const float *x,
+                                    uint32_t n) {
+  for (uint32_t i = 0; i < n; i++) {
+    if (x[i] < r->min) r->min = x[i];
+    if (x[i] > r->max) r->max = x[i];
+  }
+}
+
+#endif
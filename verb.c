@@ -28,6 +28,12 @@ The final left / right signal is combined by tapping multiple
 delay lines in the network, call functions DattorroVerb_getLeft
 and DattorroVerb_getRight for 100% wet stereo signal.
 
+Delay buffers are mirrored: the first DELAY_MIRROR samples are duplicated
+past the end of the buffer on every write. DattorroVerb_process_block runs
+the tank for a whole chunk first and then sums the 14 output taps over
+contiguous spans, so the tap mix is plain vector adds with no index
+wrapping.
+
 My github:     https://github.com/el-visio
 */
 
@@ -77,12 +83,12 @@ void DelayBuffer_init(DelayBuffer* db, uint16_t delay) {
   // Buffer size is always 2^n
   bufferSize = 1 << numBits;
 
-  // Allocate buffer
-  db->buffer = malloc(bufferSize * sizeof(float));
+  // Allocate buffer with mirrored tail
+  db->buffer = malloc((bufferSize + DELAY_MIRROR) * sizeof(float));
   if (!db->buffer) return;
 
   // Clear buffer
-  memset(db->buffer, 0, bufferSize * sizeof(float));
+  memset(db->buffer, 0, (bufferSize + DELAY_MIRROR) * sizeof(float));
 
   // Create bitmask for fast wrapping of the circular buffer
   db->mask = bufferSize - 1;
@@ -95,15 +101,22 @@ void DelayBuffer_delete(DelayBuffer* db) {
   db->buffer = 0;
 }
 
-/* Write input value into buffer, read delayed output */
-float DelayBuffer_process(DelayBuffer* db, uint16_t t, float in) {
-  db->buffer[t & db->mask] = in;
-  return db->buffer[(t + db->readOffset[TAP_MAIN]) & db->mask];
+/* Zero the delay memory, including the mirrored tail */
+void DelayBuffer_clear(DelayBuffer* db) {
+  memset(db->buffer, 0, (db->mask + 1 + DELAY_MIRROR) * sizeof(float));
 }
 
-/* Write value into delay buffer */
+/* Write value into delay buffer, keeping the mirrored tail in sync */
 void DelayBuffer_write(DelayBuffer* db, uint16_t t, float in) {
-  db->buffer[t & db->mask] = in;
+  uint16_t i = t & db->mask;
+  db->buffer[i] = in;
+  if (i < DELAY_MIRROR) db->buffer[i + db->mask + 1] = in;
+}
+
+/* Write input value into buffer, read delayed output */
+float DelayBuffer_process(DelayBuffer* db, uint16_t t, float in) {
+  DelayBuffer_write(db, t, in);
+  return db->buffer[(t + db->readOffset[TAP_MAIN]) & db->mask];
 }
 
 /* Read delayed output value */
@@ -111,6 +124,11 @@ float DelayBuffer_read(DelayBuffer* db, uint16_t tapId, uint16_t t) {
   return db->buffer[(t + db->readOffset[tapId]) & db->mask];
 }
 
+/* Get DELAY_MIRROR contiguous delayed values, starting at time t */
+const float* DelayBuffer_span(DelayBuffer* db, uint16_t tapId, uint16_t t) {
+  return db->buffer + ((t + db->readOffset[tapId]) & db->mask);
+}
+
 /* Apply all-pass filter */
 float AllPassFilter_process(DelayBuffer* db, uint16_t t, float gain, float in) {
   float delayed = DelayBuffer_read(db, TAP_MAIN, t);
@@ -125,45 +143,101 @@ float LowPassFilter_process(float* out, float freq, float in) {
   return *out;
 }
 
+/* Publish the control thread's working copy of the settings */
+static void publishParams(DattorroVerb* v) {
+  v->params[ParamExchange_back(&v->exchange)] = v->pending;
+  ParamExchange_publish(&v->exchange);
+}
+
 /* Set pre-delay length (relative to MAX_PREDELAY) */
 void DattorroVerb_setPreDelay(DattorroVerb* v, float value) {
-  DelayBuffer_setDelay(&v->preDelay, TAP_MAIN, value * MAX_PREDELAY);
+  v->pending.preDelay = value;
+  publishParams(v);
 }
 
 /* Set pre-filter amount */
 void DattorroVerb_setPreFilter(struct sDattorroVerb* v, float value) {
-  v->preFilterAmount = value;
+  v->pending.preFilter = value;
+  publishParams(v);
 }
 
 /* Set input diffusion 1 amount */
 void DattorroVerb_setInputDiffusion1(struct sDattorroVerb* v, float value) {
-  v->inputDiffusion1Amount = value;
+  v->pending.inputDiffusion1 = value;
+  publishParams(v);
 }
 
 /* Set input diffusion 2 amount */
 void DattorroVerb_setInputDiffusion2(struct sDattorroVerb* v, float value) {
-  v->inputDiffusion2Amount = value;
+  v->pending.inputDiffusion2 = value;
+  publishParams(v);
 }
 
 /* Set decay diffusion 1 amount */
 void DattorroVerb_setDecayDiffusion(struct sDattorroVerb* v, float value) {
-  v->decayDiffusion1Amount = value;
+  v->pending.decayDiffusion = value;
+  publishParams(v);
 }
 
-/* Set decay amount and calculate related decay diffusion 2 amount */
+/* Set decay amount, decay diffusion 2 amount follows it */
 void DattorroVerb_setDecay(DattorroVerb* v, float value) {
-  v->decayAmount = value;
-  v->decayDiffusion2Amount = clamp(value + 0.15, 0.25, 0.50);
+  v->pending.decay = value;
+  publishParams(v);
 }
 
 /* Set damping amount */
 void DattorroVerb_setDamping(struct sDattorroVerb* v, float value) {
-  v->dampingAmount = value;
+  v->pending.damping = value;
+  publishParams(v);
+}
+
+/* Pick up a fresh settings snapshot, new values ramp in over the next block */
+static void acquireParams(DattorroVerb* v) {
+  if (!ParamExchange_acquire(&v->exchange)) return;
+
+  const DattorroVerbParams* p = &v->params[ParamExchange_front(&v->exchange)];
+
+  // Delay lengths can't be interpolated, pre-delay changes at the boundary
+  DelayBuffer_setDelay(&v->preDelay, TAP_MAIN, p->preDelay * MAX_PREDELAY);
+
+  SmoothedParam_set(&v->preFilterAmount, p->preFilter);
+  SmoothedParam_set(&v->inputDiffusion1Amount, p->inputDiffusion1);
+  SmoothedParam_set(&v->inputDiffusion2Amount, p->inputDiffusion2);
+  SmoothedParam_set(&v->decayDiffusion1Amount, p->decayDiffusion);
+  SmoothedParam_set(&v->dampingAmount, p->damping);
+  SmoothedParam_set(&v->decayAmount, p->decay);
+  SmoothedParam_set(&v->decayDiffusion2Amount,
+                    clamp(p->decay + 0.15f, 0.25f, 0.50f));
+}
+
+/* Set up settings ramps for a block of n samples, true if any moves */
+static bool beginParams(DattorroVerb* v, uint16_t n) {
+  bool moving = false;
+  moving |= SmoothedParam_begin_block(&v->preFilterAmount, n);
+  moving |= SmoothedParam_begin_block(&v->inputDiffusion1Amount, n);
+  moving |= SmoothedParam_begin_block(&v->inputDiffusion2Amount, n);
+  moving |= SmoothedParam_begin_block(&v->decayDiffusion1Amount, n);
+  moving |= SmoothedParam_begin_block(&v->dampingAmount, n);
+  moving |= SmoothedParam_begin_block(&v->decayAmount, n);
+  moving |= SmoothedParam_begin_block(&v->decayDiffusion2Amount, n);
+  return moving;
+}
+
+/* Advance the settings ramps by one sample */
+static void rampParams(DattorroVerb* v) {
+  SmoothedParam_next(&v->preFilterAmount);
+  SmoothedParam_next(&v->inputDiffusion1Amount);
+  SmoothedParam_next(&v->inputDiffusion2Amount);
+  SmoothedParam_next(&v->decayDiffusion1Amount);
+  SmoothedParam_next(&v->dampingAmount);
+  SmoothedParam_next(&v->decayAmount);
+  SmoothedParam_next(&v->decayDiffusion2Amount);
 }
 
 /* Initialize DattorroVerb instance */
 void initialize(DattorroVerb* v) {
   memset(v, 0, sizeof(DattorroVerb));
+  ParamExchange_init(&v->exchange);
 
   // Init delay buffers using Jon Dattorro's magic numbers
   DelayBuffer_init(&v->preDelay, MAX_PREDELAY);
@@ -211,6 +285,11 @@ void initialize(DattorroVerb* v) {
   DattorroVerb_setDecay(v, 0.75);
   DattorroVerb_setDecayDiffusion(v, 0.70);
   DattorroVerb_setDamping(v, 0.95);
+
+  // Start on the defaults instead of ramping up from zero
+  acquireParams(v);
+  beginParams(v, 1);
+  rampParams(v);
 }
 
 /* Get pointer to initialized DattorroVerb instance */
@@ -241,12 +320,33 @@ void DattorroVerb_delete(DattorroVerb* v) {
   free(v);
 }
 
-// Process mono audio
-//
-// After calling this function you can
-// get wet stereo reverb signal by calling
-// DattorroVerb_getLeft and DattorroVerb_getRight
-void DattorroVerb_process(DattorroVerb* v, float in) {
+/* Silence the tank and jump straight to the current settings */
+void DattorroVerb_clear(DattorroVerb* v) {
+  DelayBuffer_clear(&v->preDelay);
+  for (int i = 0; i < 4; i++) {
+    DelayBuffer_clear(&v->inDiffusion[i]);
+  }
+  for (int i = 0; i < 2; i++) {
+    DelayBuffer_clear(&v->decayDiffusion1[i]);
+    DelayBuffer_clear(&v->preDampingDelay[i]);
+    DelayBuffer_clear(&v->decayDiffusion2[i]);
+    DelayBuffer_clear(&v->postDampingDelay[i]);
+    v->damping[i] = 0;
+  }
+  v->preFilter = 0;
+  v->t = 0;
+
+  // Undo the excursion modulation, which restarts with t
+  DelayBuffer_setDelay(&v->decayDiffusion1[0], TAP_MAIN, 672);
+  DelayBuffer_setDelay(&v->decayDiffusion1[1], TAP_MAIN, 908);
+
+  acquireParams(v);
+  beginParams(v, 1);
+  rampParams(v);
+}
+
+/* Run the network for one input sample */
+static void processTank(DattorroVerb* v, float in) {
   float x, x1;
 
   // Modulate decayDiffusion1A & decayDiffusion1B
@@ -264,31 +364,31 @@ void DattorroVerb_process(DattorroVerb* v, float in) {
   x = DelayBuffer_process(&v->preDelay, v->t, in);
 
   // Pre-filter
-  x = LowPassFilter_process(&v->preFilter, v->preFilterAmount, x);
+  x = LowPassFilter_process(&v->preFilter, v->preFilterAmount.value, x);
 
   // Input diffusion
-  x = AllPassFilter_process(&v->inDiffusion[0], v->t, v->inputDiffusion1Amount,
-                            x);
-  x = AllPassFilter_process(&v->inDiffusion[1], v->t, v->inputDiffusion1Amount,
-                            x);
-  x = AllPassFilter_process(&v->inDiffusion[2], v->t, v->inputDiffusion2Amount,
-                            x);
-  x = AllPassFilter_process(&v->inDiffusion[3], v->t, v->inputDiffusion2Amount,
-                            x);
+  x = AllPassFilter_process(&v->inDiffusion[0], v->t,
+                            v->inputDiffusion1Amount.value, x);
+  x = AllPassFilter_process(&v->inDiffusion[1], v->t,
+                            v->inputDiffusion1Amount.value, x);
+  x = AllPassFilter_process(&v->inDiffusion[2], v->t,
+                            v->inputDiffusion2Amount.value, x);
+  x = AllPassFilter_process(&v->inDiffusion[3], v->t,
+                            v->inputDiffusion2Amount.value, x);
 
   for (int i = 0; i < 2; i++) {
     // Add cross feedback
     x1 = x + DelayBuffer_read(&v->postDampingDelay[1 - i], TAP_MAIN, v->t) *
-                 v->decayAmount;
+                 v->decayAmount.value;
 
     // Process single half of the tank
     x1 = AllPassFilter_process(&v->decayDiffusion1[i], v->t,
-                               -v->decayDiffusion1Amount, x1);
+                               -v->decayDiffusion1Amount.value, x1);
     x1 = DelayBuffer_process(&v->preDampingDelay[i], v->t, x1);
-    x1 = LowPassFilter_process(&v->damping[i], v->dampingAmount, x1);
-    x1 *= v->decayAmount;
+    x1 = LowPassFilter_process(&v->damping[i], v->dampingAmount.value, x1);
+    x1 *= v->decayAmount.value;
     x1 = AllPassFilter_process(&v->decayDiffusion2[i], v->t,
-                               v->decayDiffusion2Amount, x1);
+                               v->decayDiffusion2Amount.value, x1);
     DelayBuffer_write(&v->postDampingDelay[i], v->t, x1);
   }
 
@@ -296,6 +396,19 @@ void DattorroVerb_process(DattorroVerb* v, float in) {
   v->t++;
 }
 
+// Process mono audio
+//
+// After calling this function you can
+// get wet stereo reverb signal by calling
+// DattorroVerb_getLeft and DattorroVerb_getRight
+//
+// Settings changes apply from this sample on, without a ramp
+void DattorroVerb_process(DattorroVerb* v, float in) {
+  acquireParams(v);
+  if (beginParams(v, 1)) rampParams(v);
+  processTank(v, in);
+}
+
 // Get left channel reverb
 float DattorroVerb_getLeft(DattorroVerb* v) {
   float a;
@@ -321,3 +434,63 @@ float DattorroVerb_getRight(DattorroVerb* v) {
   a += DelayBuffer_read(&v->postDampingDelay[1], TAP_OUT1, v->t);
   return a;
 }
+
+// Process mono audio in blocks
+//
+// Writes n samples of wet stereo reverb into outL / outR. Settings published
+// since the previous call ramp linearly to their new values across the block.
+//
+// Works in chunks of up to DELAY_MIRROR samples: the tank runs sample by
+// sample, then the output taps for the whole chunk are summed from
+// contiguous spans. This is safe because every output tap is shorter than
+// its buffer by more than DELAY_MIRROR samples, so no tap value is
+// overwritten within a chunk.
+void DattorroVerb_process_block(DattorroVerb* v, const float* in, float* outL,
+                                float* outR, uint16_t n) {
+  acquireParams(v);
+  bool ramping = beginParams(v, n);
+
+  while (n) {
+    uint16_t m = n < DELAY_MIRROR ? n : DELAY_MIRROR;
+    // Taps are read after the increment, as in DattorroVerb_getLeft
+    uint16_t t = v->t + 1;
+
+    if (ramping) {
+      for (uint16_t i = 0; i < m; i++) {
+        rampParams(v);
+        processTank(v, in[i]);
+      }
+    } else {
+      for (uint16_t i = 0; i < m; i++) {
+        processTank(v, in[i]);
+      }
+    }
+
+    const float* l0 = DelayBuffer_span(&v->preDampingDelay[1], TAP_OUT1, t);
+    const float* l1 = DelayBuffer_span(&v->preDampingDelay[1], TAP_OUT2, t);
+    const float* l2 = DelayBuffer_span(&v->decayDiffusion2[1], TAP_OUT2, t);
+    const float* l3 = DelayBuffer_span(&v->postDampingDelay[1], TAP_OUT2, t);
+    const float* l4 = DelayBuffer_span(&v->preDampingDelay[0], TAP_OUT3, t);
+    const float* l5 = DelayBuffer_span(&v->decayDiffusion2[0], TAP_OUT1, t);
+    const float* l6 = DelayBuffer_span(&v->postDampingDelay[0], TAP_OUT1, t);
+    for (uint16_t i = 0; i < m; i++) {
+      outL[i] = l0[i] + l1[i] - l2[i] + l3[i] - l4[i] - l5[i] + l6[i];
+    }
+
+    const float* r0 = DelayBuffer_span(&v->preDampingDelay[0], TAP_OUT1, t);
+    const float* r1 = DelayBuffer_span(&v->preDampingDelay[0], TAP_OUT2, t);
+    const float* r2 = DelayBuffer_span(&v->decayDiffusion2[0], TAP_OUT2, t);
+    const float* r3 = DelayBuffer_span(&v->postDampingDelay[0], TAP_OUT2, t);
+    const float* r4 = DelayBuffer_span(&v->preDampingDelay[1], TAP_OUT3, t);
+    const float* r5 = DelayBuffer_span(&v->decayDiffusion2[1], TAP_OUT1, t);
+    const float* r6 = DelayBuffer_span(&v->postDampingDelay[1], TAP_OUT1, t);
+    for (uint16_t i = 0; i < m; i++) {
+      outR[i] = r0[i] + r1[i] - r2[i] + r3[i] - r4[i] - r5[i] + r6[i];
+    }
+
+    in += m;
+    outL += m;
+    outR += m;
+    n -= m;
+  }
+}
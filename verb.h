@@ -1,3 +1,5 @@
+#include <stdint.h>
+
 struct sDattorroVerb;
 
 /* Get pointer to initialized DattorroVerb struct */
@@ -6,7 +8,12 @@ struct sDattorroVerb* DattorroVerb_create(void);
 /* Free resources and delete DattorroVerb instance */
 void DattorroVerb_delete(struct sDattorroVerb* v);
 
-/* Set reverb parameters */
+/* Silence the reverb for reuse, settings made so far apply without ramping */
+void DattorroVerb_clear(struct sDattorroVerb* v);
+
+/* Set reverb parameters. One control thread may call these while another
+   thread is processing: each call publishes a complete settings snapshot
+   without locking, which the audio side picks up at its next block. */
 void DattorroVerb_setPreDelay(struct sDattorroVerb* v, float value);
 void DattorroVerb_setPreFilter(struct sDattorroVerb* v, float value);
 void DattorroVerb_setInputDiffusion1(struct sDattorroVerb* v, float value);
@@ -23,3 +30,7 @@ float DattorroVerb_getLeft(struct sDattorroVerb* v);
 
 /* Get reverbated signal for right channel */
 float DattorroVerb_getRight(struct sDattorroVerb* v);
+
+/* Process n mono input samples into wet stereo output */
+void DattorroVerb_process_block(struct sDattorroVerb* v, const float* in,
+                                float* outL, float* outR, uint16_t n);
@@ -1,10 +1,18 @@
 #include <stdint.h>
 
+#include "params.h"
+#include "smooth.h"
+
 enum { TAP_MAIN = 0, TAP_OUT1, TAP_OUT2, TAP_OUT3, MAX_TAPS };
 
+// Length of the mirrored tail behind every delay buffer. Any window of up to
+// DELAY_MIRROR samples can be read as one contiguous span without wrapping.
+#define DELAY_MIRROR 256
+
 /* DelayBuffer context, also used in AllPassFilter */
 typedef struct sDelayBuffer {
-  // Sample buffer
+  // Sample buffer, mask + 1 samples followed by a copy of the first
+  // DELAY_MIRROR samples
   float* buffer;
 
   // Mask for fast array index wrapping in read / write
@@ -14,6 +22,17 @@ typedef struct sDelayBuffer {
   uint16_t readOffset[MAX_TAPS];
 } DelayBuffer;
 
+/* Reverb settings as set through the DattorroVerb_set* functions */
+typedef struct sDattorroVerbParams {
+  float preDelay;
+  float preFilter;
+  float inputDiffusion1;
+  float inputDiffusion2;
+  float decayDiffusion;
+  float decay;
+  float damping;
+} DattorroVerbParams;
+
 /* DattorroVerb context */
 typedef struct sDattorroVerb {
   // -- Reverb feedback network components --
@@ -34,16 +53,21 @@ typedef struct sDattorroVerb {
   DelayBuffer decayDiffusion2[2];   // APF
   DelayBuffer postDampingDelay[2];  // Delay
 
-  // -- Reverb settings --
-  float preFilterAmount;
+  // -- Reverb settings, ramped at block rate --
+  SmoothedParam preFilterAmount;
+
+  SmoothedParam inputDiffusion1Amount;
+  SmoothedParam inputDiffusion2Amount;
 
-  float inputDiffusion1Amount;
-  float inputDiffusion2Amount;
+  SmoothedParam decayDiffusion1Amount;
+  SmoothedParam dampingAmount;
+  SmoothedParam decayAmount;
+  SmoothedParam decayDiffusion2Amount;  // Derived from decayAmount
 
-  float decayDiffusion1Amount;
-  float dampingAmount;
-  float decayAmount;
-  float decayDiffusion2Amount;  // Automatically set in DattorroVerb_setDecay
+  // -- Settings exchange with the control thread --
+  DattorroVerbParams params[PARAMS_SLOTS];
+  DattorroVerbParams pending;  // Control thread working copy
+  ParamExchange exchange;
 
   // Cycle count for syncing delay lines
   uint16_t t;
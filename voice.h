@@ -0,0 +1,335 @@
+#ifndef VOICE_LIB
+#define VOICE_LIB 1
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "adsr.h"
+#include "params.h"
+#include "smooth.h"
+
+// xorshift32 in [0, 1). Voices keep their own state, rand() takes a global
+// lock on every call and would serialize voices rendered on several threads.
+static inline float Random_next(uint32_t *state) {
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return (x >> 8) * (1.0f / 16777216);
+}
+
+// any seed, including 0, gives a valid xorshift state
+static inline uint32_t Random_seed(uint32_t seed) {
+  return seed * 2654435761u | 1;
+}
+
+// create a saw wave struct
+typedef struct LFSaw {
+  float phase;
+  float sample_rate;
+  float amplitude;
+  float phase_increment;
+} LFSaw;
+
+static inline void LFSaw_init(LFSaw *saw, float freq, float sample_rate,
+                              float amplitude, float phase) {
+  saw->phase = phase;
+  saw->sample_rate = sample_rate;
+  saw->amplitude = amplitude;
+  saw->phase_increment = freq / sample_rate;
+}
+
+static inline void LFSaw_set_freq(LFSaw *saw, float freq) {
+  saw->phase_increment = freq / saw->sample_rate;
+}
+
+static inline float LFSaw_next_sample(LFSaw *saw) {
+  float next = saw->phase * saw->amplitude;
+  saw->phase += saw->phase_increment;
+  if (saw->phase >= 1) {
+    saw->phase -= 2;
+  }
+  return next;
+}
+
+// saws in the unison stack, ordered from the center outwards so that a
+// smaller count keeps the saws closest to the fundamental
+#define LFSAWS_MAX 7
+
+typedef struct LFSaws {
+  LFSaw saws[LFSAWS_MAX];
+  uint8_t count;  // saws playing
+  float freq;
+  float detune;  // detuneCurve() of the detune setting
+} LFSaws;
+
+static inline float detuneCurve(float x) {
+  // the fitted polynomial, expanded around x = 0.5 so that evaluating it in
+  // float does not cancel: within 1.2e-6 of the original on [0, 1]
+  static const float coefficients[12] = {
+      0.0979551523f, 0.261076015f, 1.20727185f,  4.75063955f,
+      -18.6035476f,  -81.164784f,  280.892017f,  877.89611f,
+      -1884.66289f,  -4835.78992f, 4339.15689f,  10028.7313f};
+  float u = x - 0.5f;
+  float y = 0;
+  for (int k = 11; k >= 0; k--) y = y * u + coefficients[k];
+  return y;
+}
+
+static const float detuneAmounts[LFSAWS_MAX] = {
+    0, -0.01952356, 0.01991221, -0.06288439, 0.06216538, -0.11002313,
+    0.10745242};
+
+static const float amplitudeAmounts[LFSAWS_MAX] = {0.8, 0.4, 0.8, 0.3,
+                                                   0.4, 0.5, 0.3};
+
+// the saws start at random phases drawn from random
+static inline void LFSaws_init(LFSaws *saws, float freq, float sample_rate,
+                               uint32_t *random) {
+  saws->count = LFSAWS_MAX;
+  saws->freq = freq;
+  saws->detune = detuneCurve(0.6);
+  float detuneFactor = freq * saws->detune;
+  for (int i = 0; i < LFSAWS_MAX; i++) {
+    LFSaw_init(&saws->saws[i], freq + detuneFactor * detuneAmounts[i],
+               sample_rate, amplitudeAmounts[i] / 4.0f, Random_next(random));
+  }
+}
+
+static inline void LFSaws_set_freq(LFSaws *saws, float freq) {
+  saws->freq = freq;
+  float detuneFactor = freq * saws->detune;
+  for (int i = 0; i < LFSAWS_MAX; i++) {
+    LFSaw_set_freq(&saws->saws[i], freq + detuneFactor * detuneAmounts[i]);
+  }
+}
+
+// spread of the unison saws, 0 (none) to 1 (widest), 0.6 by default
+static inline void LFSaws_set_detune(LFSaws *saws, float detune) {
+  saws->detune = detuneCurve(detune);
+  LFSaws_set_freq(saws, saws->freq);
+}
+
+// number of saws playing, 1 to LFSAWS_MAX
+static inline void LFSaws_set_unison(LFSaws *saws, uint8_t count) {
+  if (count < 1) count = 1;
+  if (count > LFSAWS_MAX) count = LFSAWS_MAX;
+  saws->count = count;
+}
+
+static inline float LFSaws_next_sample(LFSaws *saws) {
+  float next = 0;
+  for (int i = 0; i < saws->count; i++) {
+    next += LFSaw_next_sample(&saws->saws[i]);
+  }
+  return next;
+}
+
+typedef struct WhiteNoise {
+  float amplitude;
+  uint32_t random;
+} WhiteNoise;
+
+static inline void WhiteNoise_init(WhiteNoise *noise, float amplitude,
+                                   uint32_t seed) {
+  noise->amplitude = amplitude;
+  noise->random = Random_seed(seed);
+}
+
+static inline float WhiteNoise_next_sample(WhiteNoise *noise) {
+  return (Random_next(&noise->random) - 0.5f) * noise->amplitude;
+}
+
+typedef struct OnePole {
+  float prev_out;
+} OnePole;
+
+// out(i) = ((1 - abs(coef)) * in(i)) + (coef * out(i-1)).
+static inline float OnePole_next(OnePole *self, float in, float coef) {
+  float out = ((1 - fabsf(coef)) * in) + (coef * self->prev_out);
+  self->prev_out = out;
+  return out;
+}
+
+// voice settings that may be changed from a control thread
+// settings of a voice the control thread can change, see Voice_set_*
+enum {
+  VOICE_FREQ,
+  VOICE_AMP,
+  VOICE_FILTER,
+  VOICE_SUSTAIN,
+  VOICE_RELEASE,
+  VOICE_PARAMS
+};
+
+typedef struct VoiceParams {
+  float freq;
+  float amp;
+  float filter;
+  float sustain;
+  float release;
+  // bumped by each setter, so the audio thread can tell which settings were
+  // set since its last snapshot, even ones set back to an earlier value
+  uint32_t changes[VOICE_PARAMS];
+} VoiceParams;
+
+// the filter coefficient jitters randomly above its base setting
+#define FILTER_JITTER 0.18f
+
+typedef struct Voice {
+  LFSaws saws;
+  OnePole one_pole;
+  ADSR adsr;
+  WhiteNoise noise;
+  SmoothedParam amp;
+  SmoothedParam filter;  // one pole base coefficient
+  uint32_t random;       // filter jitter and saw phases
+  // settings exchange, picked up by Voice_begin_block
+  VoiceParams params[PARAMS_SLOTS];
+  VoiceParams pending;
+  VoiceParams applied;  // last snapshot taken, owned by the audio thread
+  ParamExchange exchange;
+} Voice;
+
+// the voice is seeded from rand(), Voice_seed makes it repeatable
+static inline void Voice_init(Voice *voice, float freq, float amp,
+                              float sample_rate) {
+  SmoothedParam_init(&voice->amp, amp);
+  SmoothedParam_init(&voice->filter, 0.8);
+  voice->random = Random_seed(rand());
+  WhiteNoise_init(&voice->noise, 0, rand());
+  LFSaws_init(&voice->saws, freq, sample_rate, &voice->random);
+  voice->one_pole.prev_out = 0;
+  ADSR_init(&voice->adsr, 4, 1, 0.707, 0.5, 2.0, sample_rate);
+  voice->pending.freq = freq;
+  voice->pending.amp = amp;
+  voice->pending.filter = voice->filter.value;
+  voice->pending.sustain = voice->adsr.sustain.value;
+  voice->pending.release = 0.5;
+  for (int i = 0; i < VOICE_PARAMS; i++) voice->pending.changes[i] = 0;
+  voice->applied = voice->pending;
+  ParamExchange_init(&voice->exchange);
+}
+
+// restart the voice's random sequences, and with them the saw phases, so
+// that renders with the same seed are identical
+static inline void Voice_seed(Voice *voice, uint32_t seed) {
+  voice->random = Random_seed(seed);
+  voice->noise.random = Random_seed(~seed);
+  for (int i = 0; i < LFSAWS_MAX; i++) {
+    voice->saws.saws[i].phase = Random_next(&voice->random);
+  }
+}
+
+// publish the pending settings to the audio thread
+static inline void Voice_publish(Voice *voice) {
+  voice->params[ParamExchange_back(&voice->exchange)] = voice->pending;
+  ParamExchange_publish(&voice->exchange);
+}
+
+// control thread setters, applied at the start of the next block
+static inline void Voice_set_freq(Voice *voice, float freq) {
+  voice->pending.freq = freq;
+  voice->pending.changes[VOICE_FREQ]++;
+  Voice_publish(voice);
+}
+
+static inline void Voice_set_amp(Voice *voice, float amp) {
+  voice->pending.amp = amp;
+  voice->pending.changes[VOICE_AMP]++;
+  Voice_publish(voice);
+}
+
+static inline void Voice_set_filter(Voice *voice, float coef) {
+  voice->pending.filter = coef;
+  voice->pending.changes[VOICE_FILTER]++;
+  Voice_publish(voice);
+}
+
+static inline void Voice_set_sustain(Voice *voice, float sustain) {
+  voice->pending.sustain = sustain;
+  voice->pending.changes[VOICE_SUSTAIN]++;
+  Voice_publish(voice);
+}
+
+static inline void Voice_set_release(Voice *voice, float release) {
+  voice->pending.release = release;
+  voice->pending.changes[VOICE_RELEASE]++;
+  Voice_publish(voice);
+}
+
+// audio thread: pick up new settings before rendering n samples,
+// continuous settings ramp to their new values across the block. Only the
+// settings the control thread set since the last snapshot are applied, told
+// apart by their change counts rather than their values, so a snapshot
+// never undoes a change made by an event such as Voice_note_on, and a
+// setting set back to its old value is still applied.
+static inline void Voice_begin_block(Voice *voice, uint16_t n) {
+  if (ParamExchange_acquire(&voice->exchange)) {
+    VoiceParams *p = &voice->params[ParamExchange_front(&voice->exchange)];
+    uint32_t *seen = voice->applied.changes;
+    if (p->changes[VOICE_FREQ] != seen[VOICE_FREQ]) {
+      LFSaws_set_freq(&voice->saws, p->freq);
+    }
+    if (p->changes[VOICE_RELEASE] != seen[VOICE_RELEASE]) {
+      ADSR_set_release(&voice->adsr, p->release);
+    }
+    if (p->changes[VOICE_SUSTAIN] != seen[VOICE_SUSTAIN]) {
+      ADSR_set_sustain(&voice->adsr, p->sustain);
+    }
+    if (p->changes[VOICE_AMP] != seen[VOICE_AMP]) {
+      SmoothedParam_set(&voice->amp, p->amp);
+    }
+    if (p->changes[VOICE_FILTER] != seen[VOICE_FILTER]) {
+      SmoothedParam_set(&voice->filter, p->filter);
+    }
+    voice->applied = *p;
+  }
+  SmoothedParam_begin_block(&voice->amp, n);
+  SmoothedParam_begin_block(&voice->filter, n);
+  ADSR_begin_block(&voice->adsr, n);
+}
+
+static inline void Voice_gate(Voice *voice, bool gate) {
+  ADSR_gate(&voice->adsr, gate);
+}
+
+// audio thread: start a note. The pitch and level change immediately, there
+// is nothing to glide from on a new note.
+static inline void Voice_note_on(Voice *voice, float freq, float amp) {
+  LFSaws_set_freq(&voice->saws, freq);
+  SmoothedParam_init(&voice->amp, amp);
+  Voice_gate(voice, true);
+}
+
+// true once the release has finished, the voice contributes nothing
+static inline bool Voice_is_idle(Voice *voice) {
+  return voice->adsr.state == env_idle && !voice->adsr.gate;
+}
+
+static inline float Voice_next_sample(Voice *voice) {
+  float sample = 0;
+  sample += LFSaws_next_sample(&voice->saws);
+  sample += WhiteNoise_next_sample(&voice->noise);
+  // generate random number between 0.97 and 0.99
+  float random = SmoothedParam_next(&voice->filter) +
+                 Random_next(&voice->random) * FILTER_JITTER;
+  sample = OnePole_next(&voice->one_pole, sample, random);
+  sample = sample * ADSR_process(&voice->adsr);
+  sample = sample * SmoothedParam_next(&voice->amp);
+  return sample;
+}
+
+// mix n samples of the voice into out, scaled by gain
+static inline void Voice_render(Voice *voice, float *out, uint16_t n,
+                                float gain) {
+  for (uint16_t i = 0; i < n; i++) {
+    out[i] += Voice_next_sample(voice) * gain;
+  }
+}
+
+#endif
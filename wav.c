@@ -0,0 +1,282 @@
+/*
+RIFF / WAVE file support
+
+Reads the "fmt " and "data" chunks of a RIFF/WAVE file, skipping any other
+chunk. Integer PCM of 16, 24 or 32 bits and IEEE float of 32 bits are
+supported, including WAVE_FORMAT_EXTENSIBLE headers carrying either.
+
+Writes 16 or 24-bit PCM and 32-bit float. Samples are converted by the pcm.c
+kernels straight into a large aligned buffer that goes to the file in one
+write() whenever it fills; the header is written with empty sizes on open and
+patched on close.
+*/
+
+#include "wav.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "pcm.h"
+
+#define WAVE_FORMAT_PCM 0x0001
+#define WAVE_FORMAT_IEEE_FLOAT 0x0003
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+
+#define WAV_BUFFER_BYTES (1 << 18)  // bytes per write
+#define WAV_BUFFER_ALIGN 64
+#define WAV_DITHER_SEED 1
+
+static uint16_t le16(const uint8_t* p) { return p[0] | (p[1] << 8); }
+
+static uint32_t le32(const uint8_t* p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* Convert one little-endian sample to float */
+static float decodeSample(const uint8_t* p, uint16_t format, uint16_t bits) {
+  if (format == WAVE_FORMAT_IEEE_FLOAT) {
+    uint32_t u = le32(p);
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+  }
+  switch (bits) {
+    case 16:
+      return (int16_t)le16(p) / 32768.0f;
+    case 24:
+      return (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) |
+                       ((uint32_t)p[2] << 24)) /
+             2147483648.0f;
+    default:
+      return (int32_t)le32(p) / 2147483648.0f;
+  }
+}
+
+/* Read a WAV file into interleaved float samples */
+float* Wav_read(const char* path, uint16_t* channels, uint32_t* sampleRate,
+                uint32_t* frames) {
+  FILE* fp = fopen(path, "rb");
+  if (!fp) return NULL;
+
+  uint8_t header[12], chunk[8], fmt[40];
+  uint16_t format = 0, bits = 0;
+  float* samples = NULL;
+  *channels = 0;
+
+  if (fread(header, 1, 12, fp) != 12 || memcmp(header, "RIFF", 4) ||
+      memcmp(header + 8, "WAVE", 4)) {
+    fclose(fp);
+    return NULL;
+  }
+
+  while (fread(chunk, 1, 8, fp) == 8) {
+    uint32_t size = le32(chunk + 4);
+
+    if (!memcmp(chunk, "fmt ", 4) && size >= 16) {
+      uint32_t n = size < sizeof(fmt) ? size : sizeof(fmt);
+      if (fread(fmt, 1, n, fp) != n) break;
+      format = le16(fmt);
+      *channels = le16(fmt + 2);
+      *sampleRate = le32(fmt + 4);
+      bits = le16(fmt + 14);
+      if (format == WAVE_FORMAT_EXTENSIBLE && n >= 26) format = le16(fmt + 24);
+      fseek(fp, (long)(size - n + (size & 1)), SEEK_CUR);
+    } else if (!memcmp(chunk, "data", 4) && *channels) {
+      uint16_t bytes = bits / 8;
+      if (!(format == WAVE_FORMAT_PCM &&
+            (bits == 16 || bits == 24 || bits == 32)) &&
+          !(format == WAVE_FORMAT_IEEE_FLOAT && bits == 32)) {
+        break;
+      }
+
+      uint8_t* raw = malloc(size);
+      if (!raw) break;
+      size = fread(raw, 1, size, fp);  // tolerate truncated files
+
+      *frames = size / (bytes * *channels);
+      size_t count = (size_t)*frames * *channels;
+      samples = count ? malloc(count * sizeof(float)) : NULL;
+      if (samples) {
+        for (size_t i = 0; i < count; i++) {
+          samples[i] = decodeSample(raw + i * bytes, format, bits);
+        }
+      }
+      free(raw);
+      break;
+    } else {
+      fseek(fp, (long)(size + (size & 1)), SEEK_CUR);
+    }
+  }
+
+  fclose(fp);
+  return samples;
+}
+
+/* WavWriter context */
+typedef struct sWavWriter {
+  int fd;
+  uint16_t channels;
+  uint16_t format;  // WAV_PCM16, WAV_PCM24 or WAV_FLOAT32
+  uint32_t sampleRate;
+  uint16_t frameBytes;
+  bool dither;
+  PcmDither ditherState;
+  uint8_t* buffer;  // WAV_BUFFER_BYTES
+  size_t used;      // bytes waiting in buffer
+  uint64_t dataBytes;
+  bool failed;
+} WavWriter;
+
+static void put16(uint8_t* p, uint16_t x) {
+  p[0] = x;
+  p[1] = x >> 8;
+}
+
+static void put32(uint8_t* p, uint32_t x) {
+  put16(p, x);
+  put16(p + 2, x >> 16);
+}
+
+/* Fill in a header for dataBytes of samples, returns its size */
+static size_t buildHeader(const WavWriter* w, uint8_t* h, uint64_t dataBytes) {
+  bool isFloat = w->format == WAV_FLOAT32;
+  uint32_t fmtSize = isFloat ? 18 : 16;
+  size_t size = 12 + 8 + fmtSize + (isFloat ? 12 : 0) + 8;
+  uint32_t data = dataBytes > 0xFFFFFFFF - size ? 0xFFFFFFFF - size
+                                                : (uint32_t)dataBytes;
+  uint8_t* p = h;
+
+  memcpy(p, "RIFF", 4);
+  put32(p + 4, size - 8 + data + (data & 1));
+  memcpy(p + 8, "WAVE", 4);
+  p += 12;
+
+  memcpy(p, "fmt ", 4);
+  put32(p + 4, fmtSize);
+  put16(p + 8, isFloat ? WAVE_FORMAT_IEEE_FLOAT : WAVE_FORMAT_PCM);
+  put16(p + 10, w->channels);
+  put32(p + 12, w->sampleRate);
+  put32(p + 16, w->sampleRate * w->frameBytes);
+  put16(p + 20, w->frameBytes);
+  put16(p + 22, w->format);
+  if (isFloat) put16(p + 24, 0);  // cbSize
+  p += 8 + fmtSize;
+
+  if (isFloat) {
+    // non-PCM formats carry the frame count in a fact chunk
+    memcpy(p, "fact", 4);
+    put32(p + 4, 4);
+    put32(p + 8, data / w->frameBytes);
+    p += 12;
+  }
+
+  memcpy(p, "data", 4);
+  put32(p + 4, data);
+  return size;
+}
+
+/* Write out the buffered samples */
+static void flush(WavWriter* w) {
+  const uint8_t* p = w->buffer;
+  while (w->used && !w->failed) {
+    ssize_t written = write(w->fd, p, w->used);
+    if (written <= 0) {
+      w->failed = true;
+      break;
+    }
+    p += written;
+    w->used -= written;
+  }
+  w->used = 0;
+}
+
+WavWriter* WavWriter_create(uint16_t channels, uint32_t sampleRate,
+                            uint16_t format, bool dither) {
+  if ((channels != 1 && channels != 2) ||
+      (format != WAV_PCM16 && format != WAV_PCM24 && format != WAV_FLOAT32)) {
+    return NULL;
+  }
+  WavWriter* w = malloc(sizeof(WavWriter));
+  if (!w) return NULL;
+  w->buffer = aligned_alloc(WAV_BUFFER_ALIGN, WAV_BUFFER_BYTES);
+  if (!w->buffer) {
+    free(w);
+    return NULL;
+  }
+  w->fd = -1;
+  w->channels = channels;
+  w->format = format;
+  w->sampleRate = sampleRate;
+  w->frameBytes = channels * format / 8;
+  w->dither = dither && format != WAV_FLOAT32;
+  return w;
+}
+
+void WavWriter_delete(WavWriter* w) {
+  if (w->fd >= 0) WavWriter_close(w);
+  free(w->buffer);
+  free(w);
+}
+
+bool WavWriter_open(WavWriter* w, const char* path) {
+  if (w->fd >= 0) WavWriter_close(w);
+  w->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (w->fd < 0) return false;
+
+  // same dither sequence for every file, renders stay repeatable
+  PcmDither_init(&w->ditherState, WAV_DITHER_SEED);
+  w->dataBytes = 0;
+  w->failed = false;
+  w->used = buildHeader(w, w->buffer, 0);
+  return true;
+}
+
+bool WavWriter_write(WavWriter* w, const float* left, const float* right,
+                     uint32_t frames) {
+  if (w->channels == 1) right = NULL;
+  PcmDither* dither = w->dither ? &w->ditherState : NULL;
+
+  while (frames) {
+    uint32_t room = (WAV_BUFFER_BYTES - w->used) / w->frameBytes;
+    if (!room) {
+      flush(w);
+      continue;
+    }
+    uint32_t n = frames < room ? frames : room;
+    uint8_t* out = w->buffer + w->used;
+    switch (w->format) {
+      case WAV_PCM16:
+        Pcm_from_float16((int16_t*)out, left, right, n, dither);
+        break;
+      case WAV_PCM24:
+        Pcm_from_float24(out, left, right, n, dither);
+        break;
+      default:
+        Pcm_from_float32((float*)out, left, right, n);
+        break;
+    }
+    w->used += (size_t)n * w->frameBytes;
+    w->dataBytes += (uint64_t)n * w->frameBytes;
+    left += n;
+    if (right) right += n;
+    frames -= n;
+  }
+  return !w->failed;
+}
+
+bool WavWriter_close(WavWriter* w) {
+  if (w->fd < 0) return false;
+  // RIFF chunks are padded to an even size
+  if (w->dataBytes & 1) w->buffer[w->used++] = 0;
+  flush(w);
+
+  uint8_t header[64];
+  size_t size = buildHeader(w, header, w->dataBytes);
+  if (pwrite(w->fd, header, size, 0) != (ssize_t)size) w->failed = true;
+  if (close(w->fd)) w->failed = true;
+  w->fd = -1;
+  return !w->failed;
+}
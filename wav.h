@@ -0,0 +1,35 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Sample formats for WavWriter, by bits per sample */
+#define WAV_PCM16 16
+#define WAV_PCM24 24
+#define WAV_FLOAT32 32
+
+/* Read a PCM (16/24/32-bit) or 32-bit float WAV file into newly allocated
+   interleaved float samples in [-1, 1]. Returns NULL on failure, free the
+   result with free(). */
+float* Wav_read(const char* path, uint16_t* channels, uint32_t* sampleRate,
+                uint32_t* frames);
+
+struct sWavWriter;
+
+/* Create a writer for files of the given layout. The writer owns its output
+   buffer and can write any number of files one after the other, so reusing
+   it allocates nothing per file. dither applies to the PCM formats. Returns
+   NULL for an unsupported format. */
+struct sWavWriter* WavWriter_create(uint16_t channels, uint32_t sampleRate,
+                                    uint16_t format, bool dither);
+void WavWriter_delete(struct sWavWriter* w);
+
+/* Start a new file, returns false if it cannot be created */
+bool WavWriter_open(struct sWavWriter* w, const char* path);
+
+/* Append planar float samples, right is ignored for mono writers. Samples
+   are converted into the buffer, which is written out whenever it fills. */
+bool WavWriter_write(struct sWavWriter* w, const float* left,
+                     const float* right, uint32_t frames);
+
+/* Flush, fill in the header sizes and close the file. Returns false if any
+   write since WavWriter_open failed. */
+bool WavWriter_close(struct sWavWriter* w);